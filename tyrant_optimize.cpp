@@ -14,6 +14,9 @@
 //#define NDEBUG
 #define BOOST_THREAD_USE_LIB
 #include <cassert>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstring>
 #include <ctime>
 #include <iostream>
@@ -23,6 +26,7 @@
 #include <memory>
 #include <algorithm>
 #include <functional>
+#include <numeric>
 #include <random>
 #include <string>
 #include <sstream>
@@ -31,7 +35,9 @@
 #include <map>
 #include <set>
 #include <iterator>
+#include <limits>
 #include <tuple>
+#include <type_traits>
 #include <boost/utility.hpp> // because of 1.51 bug. missing include in range/any_range.hpp ?
 #include <boost/range/algorithm_ext/insert.hpp>
 #include <boost/range/any_range.hpp>
@@ -42,13 +48,14 @@
 #include <boost/range/adaptors.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/tokenizer.hpp>
-#include <boost/pool/object_pool.hpp>
 #include <boost/optional.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
-#include <boost/thread/barrier.hpp>
+#include <boost/thread/condition_variable.hpp>
 #include <boost/math/distributions/binomial.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include "rapidxml.hpp"
 //#include "timer.hpp"
 
@@ -83,6 +90,47 @@ void partial_shuffle(RandomAccessIterator first, RandomAccessIterator middle,
     }
 }
 
+// Counter-based random number generator (SplitMix64): the n-th number of the stream
+// identified by key is a hash of key + n, so that a stream can be started anywhere
+// from its key alone. 16 bytes of state.
+class CounterRng
+{
+public:
+    typedef uint64_t result_type;
+
+    explicit CounterRng(uint64_t key = 0) :
+        m_key(key),
+        m_counter(0)
+    {
+    }
+
+    static constexpr result_type min() { return(0); }
+    static constexpr result_type max() { return(std::numeric_limits<result_type>::max()); }
+
+    // Starts the stream identified by key
+    void seed(uint64_t key)
+    {
+        m_key = key;
+        m_counter = 0;
+    }
+
+    result_type operator()()
+    {
+        return(mix(m_key + ++m_counter * 0x9e3779b97f4a7c15ull));
+    }
+
+    static uint64_t mix(uint64_t z)
+    {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return(z ^ (z >> 31));
+    }
+
+private:
+    uint64_t m_key;
+    uint64_t m_counter;
+};
+
 namespace boost
 {
 namespace range
@@ -96,6 +144,31 @@ void shuffle(Range& range, UniformRandomNumberGenerator&& rand)
 using range::shuffle;
 } // namespace boost
 //---------------------- Debugging stuff ---------------------------------------
+// Build with -DCOUNT_ALLOCATIONS to count the heap allocations of each thread:
+// the battles must not allocate once the per-thread buffers are warm, or bench fails.
+#ifdef COUNT_ALLOCATIONS
+thread_local unsigned long num_allocations{0};
+// Not inlined: gcc would see an allocation paired with the wrong deallocation (-Wmismatched-new-delete)
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    ++num_allocations;
+    void* p(std::malloc(size == 0 ? 1 : size));
+    if(p == nullptr) { throw std::bad_alloc(); }
+    return(p);
+}
+__attribute__((noinline)) void* operator new[](std::size_t size)
+{
+    return(operator new(size));
+}
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+__attribute__((noinline)) void operator delete[](void* p) noexcept
+{
+    operator delete(p);
+}
+#endif
 bool debug_print(false);
 bool debug_line(false);
 #ifndef NDEBUG
@@ -116,69 +189,127 @@ bool debug_line(false);
 #else
 #define _DEBUG_MSG(format, args...)
 #endif
-// Pool-based indexed storage.
-//---------------------- Pool-based indexed storage ----------------------------
+// Contiguous indexed storage.
+//---------------------- Contiguous indexed storage ----------------------------
+// The elements live in a single buffer of fixed capacity, allocated once:
+// adding an element never moves the others (pointers to them stay valid),
+// and removing elements compacts the remaining ones in place, keeping their order.
+// Adding beyond the capacity throws rather than reallocating, in release builds too.
 template<typename T>
 class Storage
 {
 public:
-    typedef typename std::vector<T*>::size_type size_type;
+    typedef typename std::vector<T>::size_type size_type;
+    typedef typename std::vector<T>::iterator iterator;
     typedef T value_type;
-    Storage(size_type size) :
-        m_pool(sizeof(T))
+    Storage(size_type capacity)
     {
-        m_indirect.reserve(size);
+        m_elements.reserve(capacity);
     }
 
     inline T& operator[](size_type i)
     {
-        return(*m_indirect[i]);
+        return(m_elements[i]);
     }
 
     inline T& add_back()
     {
-        m_indirect.emplace_back(m_pool.construct());
-        return(*m_indirect.back());
+        if(m_elements.size() == m_elements.capacity())
+        {
+            throw std::runtime_error("While adding an element to a storage: its capacity " + to_string(m_elements.capacity()) + " is exceeded.");
+        }
+        m_elements.emplace_back();
+        return(m_elements.back());
     }
 
     template<typename Pred>
     void remove(Pred p)
     {
-        size_type head(0);
-        for(size_type current(0); current < m_indirect.size(); ++current)
-        {
-            if(p((*this)[current]))
-            {
-                m_pool.destroy(m_indirect[current]);
-            }
-            else
-            {
-                if(current != head)
-                {
-                    m_indirect[head] = m_indirect[current];
-                }
-                ++head;
-            }
-        }
-        m_indirect.erase(m_indirect.begin() + head, m_indirect.end());
+        m_elements.erase(std::remove_if(m_elements.begin(), m_elements.end(), p), m_elements.end());
     }
 
     void reset()
     {
-        for(auto index: m_indirect)
-        {
-            m_pool.destroy(index);
-        }
-        m_indirect.clear();
+        m_elements.clear();
     }
 
     inline size_type size() const
     {
-        return(m_indirect.size());
+        return(m_elements.size());
+    }
+
+    inline iterator begin() { return(m_elements.begin()); }
+    inline iterator end() { return(m_elements.end()); }
+
+    std::vector<T> m_elements;
+};
+//---------------------- Fixed-capacity double-ended queue ---------------------
+// Ring buffer of at most Capacity elements, stored inline: never allocates.
+// Adding beyond the capacity throws, in release builds too.
+template<typename T, unsigned Capacity>
+class RingDeque
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of 2");
+    static_assert(std::is_trivially_destructible<T>::value, "elements are overwritten, never destroyed");
+
+public:
+    RingDeque() :
+        m_head(0),
+        m_size(0)
+    {
+    }
+
+    template<typename... Args>
+    void emplace_back(Args&&... args)
+    {
+        check_capacity();
+        new(&m_elements[(m_head + m_size) & (Capacity - 1)]) T(std::forward<Args>(args)...);
+        ++m_size;
+    }
+
+    template<typename... Args>
+    void emplace_front(Args&&... args)
+    {
+        check_capacity();
+        m_head = (m_head - 1) & (Capacity - 1);
+        new(&m_elements[m_head]) T(std::forward<Args>(args)...);
+        ++m_size;
+    }
+
+    inline T& front()
+    {
+        assert(m_size > 0);
+        return(*reinterpret_cast<T*>(&m_elements[m_head]));
+    }
+
+    inline void pop_front()
+    {
+        assert(m_size > 0);
+        m_head = (m_head + 1) & (Capacity - 1);
+        --m_size;
+    }
+
+    void clear()
+    {
+        m_head = 0;
+        m_size = 0;
     }
 
-    std::vector<T*> m_indirect;
-    boost::object_pool<T> m_pool;
+    inline bool empty() const { return(m_size == 0); }
+    inline unsigned size() const { return(m_size); }
+
+private:
+    inline void check_capacity() const
+    {
+        if(m_size == Capacity)
+        {
+            throw std::runtime_error("While adding an element to a queue: its capacity " + to_string(Capacity) + " is exceeded.");
+        }
+    }
+
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type m_elements[Capacity];
+    unsigned m_head;
+    unsigned m_size;
 };
 //--------------------- $10 data model: card properties, etc -------------------
 enum Faction
@@ -331,6 +462,17 @@ enum gamemode_t
     tournament
 };
 
+struct CombatCard;
+
+// Groups of abilities that the battles skip entirely when no card of either deck,
+// nor any card they can summon, has them: play() is compiled once per combination.
+enum CombatFeature
+{
+    attack_modifier_feature = 1 << 0, // antiair, burst, flying, valor
+    on_attack_feature = 1 << 1, // berserk, counter, crush, disease, immobilize, leech, poison, siphon, on attacked abilities
+    all_features = (1 << 2) - 1
+};
+
 class Card
 {
 public:
@@ -375,7 +517,8 @@ public:
         m_valor(0),
         m_wall(false),
         m_skills(),
-        m_type(CardType::assault)
+        m_type(CardType::assault),
+        m_combat(nullptr)
     {
     }
 
@@ -432,7 +575,89 @@ public:
     std::vector<SkillSpec> m_skills_died;
     std::vector<SkillSpec> m_skills_attacked;
     CardType::CardType m_type;
+    const CombatCard* m_combat;
+};
+//------------------------------------------------------------------------------
+// Range over the SkillSpecs of a CombatCard.
+struct SkillRange
+{
+    typedef const SkillSpec* iterator;
+    typedef const SkillSpec* const_iterator;
+
+    SkillRange(const SkillSpec* begin_, const SkillSpec* end_) : m_begin(begin_), m_end(end_) {}
+    const SkillSpec* begin() const { return(m_begin); }
+    const SkillSpec* end() const { return(m_end); }
+    unsigned size() const { return(m_end - m_begin); }
+
+    const SkillSpec* m_begin;
+    const SkillSpec* m_end;
 };
+//------------------------------------------------------------------------------
+// Read-only copy of a Card with only what the simulation needs, packed in one
+// cache line. The skills of all the cards sit in Cards::combat_skills: the
+// skills of a card, then its played, died and attacked skills, then its skills
+// once infused (the faction specific ones turned bloodthirsty).
+// In these skills, the summon targets are indices in Cards::combat_cards (no_combat_card:
+// no such card) instead of card ids.
+// Built by Cards::organize; the simulation only sees CombatCards, Card is for I/O.
+struct CombatCard
+{
+    const Card* m_source;
+    const SkillSpec* m_skill_specs;
+    uint16_t m_attack;
+    uint16_t m_health;
+    uint8_t m_delay;
+    uint8_t m_antiair;
+    uint8_t m_armored;
+    uint8_t m_berserk;
+    uint8_t m_berserk_oa;
+    uint8_t m_burst;
+    uint8_t m_counter;
+    uint8_t m_crush;
+    uint8_t m_flurry;
+    uint8_t m_leech;
+    uint8_t m_pierce;
+    uint8_t m_poison;
+    uint8_t m_poison_oa;
+    uint8_t m_regenerate;
+    uint8_t m_siphon;
+    uint8_t m_valor;
+    uint8_t m_num_skills;
+    uint8_t m_num_skills_played;
+    uint8_t m_num_skills_died;
+    uint8_t m_num_skills_attacked;
+    uint8_t m_features; // CombatFeature mask, including the summoned cards
+    Faction m_faction: 8;
+    CardType::CardType m_type: 8;
+    bool m_blitz: 1;
+    bool m_disease: 1;
+    bool m_disease_oa: 1;
+    bool m_evade: 1;
+    bool m_fear: 1;
+    bool m_flying: 1;
+    bool m_immobilize: 1;
+    bool m_intercept: 1;
+    bool m_payback: 1;
+    bool m_recharge: 1;
+    bool m_refresh: 1;
+    bool m_split: 1;
+    bool m_swipe: 1;
+    bool m_tribute: 1;
+    bool m_wall: 1;
+
+    SkillRange skills() const
+    { return(SkillRange(m_skill_specs, m_skill_specs + m_num_skills)); }
+    SkillRange skills_played() const
+    { return(SkillRange(skills().end(), skills().end() + m_num_skills_played)); }
+    SkillRange skills_died() const
+    { return(SkillRange(skills_played().end(), skills_played().end() + m_num_skills_died)); }
+    SkillRange skills_attacked() const
+    { return(SkillRange(skills_died().end(), skills_died().end() + m_num_skills_attacked)); }
+    SkillRange skills_infused() const
+    { return(SkillRange(skills_attacked().end(), skills_attacked().end() + m_num_skills)); }
+};
+static_assert(sizeof(CombatCard) <= 64, "CombatCard should fit in a cache line");
+const unsigned no_combat_card{std::numeric_limits<unsigned>::max()};
 
 struct Cards
 {
@@ -441,23 +666,42 @@ struct Cards
         for(Card* c: cards) { delete(c); }
     }
 
+    // Back to no card at all
+    void clear()
+    {
+        for(Card* c: cards) { delete(c); }
+        *this = Cards();
+    }
+
     std::vector<Card*> cards;
-    std::map<unsigned, Card*> cards_by_id;
+    // Indexed by id, nullptr where there is no card.
+    std::vector<Card*> cards_by_id;
     std::vector<Card*> player_cards;
     std::map<std::string, Card*> player_cards_by_name;
     std::vector<Card*> player_commanders;
     std::vector<Card*> player_assaults;
     std::vector<Card*> player_structures;
     std::vector<Card*> player_actions;
-    std::map<unsigned, unsigned> replace;
+    // Replacement art cards: indexed by id, 0 where the card is not replaced.
+    std::vector<unsigned> replace;
+    std::vector<CombatCard> combat_cards;
+    std::vector<SkillSpec> combat_skills;
     const Card * by_id(unsigned id) const;
+    void add_replacement(unsigned id, unsigned replacement)
+    {
+        if(id >= replace.size()) { replace.resize(id + 1, 0); }
+        replace[id] = replacement;
+    }
+    unsigned replacement(unsigned id) const
+    { return(id < replace.size() && replace[id] != 0 ? replace[id] : id); }
     void organize();
+    void build_combat_cards();
 };
 Cards globalCards;
 //------------------------------------------------------------------------------
 struct CardStatus
 {
-    const Card* m_card;
+    const CombatCard* m_card;
     unsigned m_index;
     unsigned m_player;
     unsigned m_augmented;
@@ -471,8 +715,7 @@ struct CardStatus
     bool m_frozen;
     unsigned m_hp;
     bool m_immobilized;
-    bool m_infused;
-    std::vector<SkillSpec> infused_skills;
+    bool m_infused; // plays skills_infused() instead of skills()
     bool m_jammed;
     unsigned m_poisoned;
     unsigned m_protected;
@@ -481,7 +724,7 @@ struct CardStatus
 
     CardStatus() {}
 
-    CardStatus(const Card* card) :
+    CardStatus(const CombatCard* card) :
         m_card(card),
         m_index(0),
         m_player(0),
@@ -505,12 +748,12 @@ struct CardStatus
     {
     }
 
-    inline void set(const Card* card)
+    inline void set(const CombatCard* card)
     {
         this->set(*card);
     }
 
-    inline void set(const Card& card)
+    inline void set(const CombatCard& card)
     {
         m_card = &card;
         m_index = 0;
@@ -526,7 +769,6 @@ struct CardStatus
         m_frozen = false;
         m_hp = card.m_health;
         m_immobilized = false;
-        infused_skills.clear();
         m_infused = false;
         m_jammed = false;
         m_poisoned = 0;
@@ -535,13 +777,15 @@ struct CardStatus
         m_weakened = 0;
     }
 };
+// No heap memory: copied as plain bytes.
+static_assert(std::is_trivially_copyable<CardStatus>::value, "CardStatus should be trivially copyable");
 //------------------------------------------------------------------------------
 struct PlayedCard
 {
-    const Card* card;
+    const CombatCard* card;
     CardStatus* status;
     PlayedCard() : card(nullptr), status(nullptr) {}
-    PlayedCard(const Card* card_, CardStatus* status_) : card(card_), status(status_) {}
+    PlayedCard(const CombatCard* card_, CardStatus* status_) : card(card_), status(status_) {}
 };
 //---------------------- $20 cards.xml parsing ---------------------------------
 // Sets: 1 enclave; 2 nexus; 3 blight; 4 purity; 5 homeworld;
@@ -642,22 +886,106 @@ void handle_skill(xml_node<>* node, Card* card)
     }
 }
 //------------------------------------------------------------------------------
-const Card* Cards::by_id(unsigned id) const
+template<unsigned Card::*Value>
+void handle_passive_value(xml_node<>* node, Card* card)
+{
+    card->*Value = skill_value(node);
+}
+
+template<unsigned Card::*Value, unsigned Card::*ValueOnAttacked>
+void handle_passive_value_or_attacked(xml_node<>* node, Card* card)
+{
+    card->*(node->first_attribute("attacked") ? ValueOnAttacked : Value) = skill_value(node);
+}
+
+template<bool Card::*Flag>
+void handle_passive_flag(xml_node<>* node, Card* card)
+{
+    card->*Flag = true;
+}
+
+template<bool Card::*Flag, bool Card::*FlagOnAttacked>
+void handle_passive_flag_or_attacked(xml_node<>* node, Card* card)
+{
+    card->*(node->first_attribute("attacked") ? FlagOnAttacked : Flag) = true;
+}
+
+// <skill id="..."> -> handler of the node. Sorted by skill id for parse_skill.
+typedef std::pair<const char*, void(*)(xml_node<>*, Card*)> SkillParser;
+const SkillParser skill_parsers[] = {
+    {"antiair", handle_passive_value<&Card::m_antiair>},
+    {"armored", handle_passive_value<&Card::m_armored>},
+    {"augment", handle_skill<augment>},
+    {"berserk", handle_passive_value_or_attacked<&Card::m_berserk, &Card::m_berserk_oa>},
+    {"blitz", handle_passive_flag<&Card::m_blitz>},
+    {"burst", handle_passive_value<&Card::m_burst>},
+    {"chaos", handle_skill<chaos>},
+    {"cleanse", handle_skill<cleanse>},
+    {"counter", handle_passive_value<&Card::m_counter>},
+    {"crush", handle_passive_value<&Card::m_crush>},
+    {"disease", handle_passive_flag_or_attacked<&Card::m_disease, &Card::m_disease_oa>},
+    {"enfeeble", handle_skill<enfeeble>},
+    {"evade", handle_passive_flag<&Card::m_evade>},
+    {"fear", handle_passive_flag<&Card::m_fear>},
+    {"flurry", handle_passive_value<&Card::m_flurry>},
+    {"flying", handle_passive_flag<&Card::m_flying>},
+    {"freeze", handle_skill<freeze>},
+    {"heal", handle_skill<heal>},
+    {"immobilize", handle_passive_flag<&Card::m_immobilize>},
+    {"infuse", handle_skill<infuse>},
+    {"intercept", handle_passive_flag<&Card::m_intercept>},
+    {"jam", handle_skill<jam>},
+    {"leech", handle_passive_value<&Card::m_leech>},
+    {"mimic", handle_skill<mimic>},
+    {"payback", handle_passive_flag<&Card::m_payback>},
+    {"pierce", handle_passive_value<&Card::m_pierce>},
+    {"poison", handle_passive_value_or_attacked<&Card::m_poison, &Card::m_poison_oa>},
+    {"protect", handle_skill<protect>},
+    {"rally", handle_skill<rally>},
+    {"recharge", handle_passive_flag<&Card::m_recharge>},
+    {"refresh", handle_passive_flag<&Card::m_refresh>},
+    {"regenerate", handle_passive_value<&Card::m_regenerate>},
+    {"rush", handle_skill<rush>},
+    {"shock", handle_skill<shock>},
+    {"siege", handle_skill<siege>},
+    {"siphon", handle_passive_value<&Card::m_siphon>},
+    {"split", handle_passive_flag<&Card::m_split>},
+    {"strike", handle_skill<strike>},
+    {"summon", handle_skill<summon>},
+    {"supply", handle_skill<supply>},
+    {"swipe", handle_passive_flag<&Card::m_swipe>},
+    {"tribute", handle_passive_flag<&Card::m_tribute>},
+    {"valor", handle_passive_value<&Card::m_valor>},
+    {"wall", handle_passive_flag<&Card::m_wall>},
+    {"weaken", handle_skill<weaken>},
+};
+
+// Unknown skills are ignored.
+void parse_skill(xml_node<>* node, Card* card)
 {
-    std::map<unsigned, Card*>::const_iterator cardIter{cards_by_id.find(id)};
-    if(cardIter == cards_by_id.end())
+    const char* skill_id(node->first_attribute("id")->value());
+    auto parser = std::lower_bound(std::begin(skill_parsers), std::end(skill_parsers), skill_id,
+        [](const SkillParser& parser, const char* id) { return(strcmp(parser.first, id) < 0); });
+    if(parser != std::end(skill_parsers) && strcmp(parser->first, skill_id) == 0)
     {
-        throw std::runtime_error("While trying to find the card with id " + to_string(id) + ": no such key in the cards_by_id map.");
+        parser->second(node, card);
     }
-    else
+}
+//------------------------------------------------------------------------------
+const Card* Cards::by_id(unsigned id) const
+{
+    if(id >= cards_by_id.size() || cards_by_id[id] == nullptr)
     {
-        return(cardIter->second);
+        throw std::runtime_error("While trying to find the card with id " + to_string(id) + ": no such card.");
     }
+    return(cards_by_id[id]);
 }
 //------------------------------------------------------------------------------
 void Cards::organize()
 {
-    cards_by_id.clear();
+    unsigned max_id(0);
+    for(Card* card: cards) { max_id = std::max(max_id, card->m_id); }
+    cards_by_id.assign(cards.empty() ? 0 : max_id + 1, nullptr);
     player_cards.clear();
     player_cards_by_name.clear();
     player_commanders.clear();
@@ -701,6 +1029,113 @@ void Cards::organize()
             }
         }
     }
+    build_combat_cards();
+}
+//------------------------------------------------------------------------------
+template<typename T>
+T combat_value(const Card* card, const char* what, unsigned value)
+{
+    if(value > std::numeric_limits<T>::max())
+    {
+        throw std::runtime_error("While packing the card [" + card->m_name + ", id " + to_string(card->m_id) + "]: " + what + " " + to_string(value) + " is too large.");
+    }
+    return(value);
+}
+
+void Cards::build_combat_cards()
+{
+    combat_cards.clear();
+    combat_skills.clear();
+    // No reallocation afterwards: the cards point into both vectors.
+    combat_cards.reserve(cards.size());
+    for(Card* card: cards)
+    {
+        combat_skills.insert(combat_skills.end(), card->m_skills.begin(), card->m_skills.end());
+        combat_skills.insert(combat_skills.end(), card->m_skills_played.begin(), card->m_skills_played.end());
+        combat_skills.insert(combat_skills.end(), card->m_skills_died.begin(), card->m_skills_died.end());
+        combat_skills.insert(combat_skills.end(), card->m_skills_attacked.begin(), card->m_skills_attacked.end());
+        for(const SkillSpec& skill: card->m_skills)
+        {
+            combat_skills.emplace_back(std::get<0>(skill), std::get<1>(skill), std::get<2>(skill) == allfactions ? allfactions : bloodthirsty);
+        }
+    }
+    const SkillSpec* skill_specs{combat_skills.data()};
+    for(Card* card: cards)
+    {
+        CombatCard c;
+        c.m_source = card;
+        c.m_skill_specs = skill_specs;
+        c.m_attack = combat_value<uint16_t>(card, "attack", card->m_attack);
+        c.m_health = combat_value<uint16_t>(card, "health", card->m_health);
+        c.m_delay = combat_value<uint8_t>(card, "delay", card->m_delay);
+        c.m_antiair = combat_value<uint8_t>(card, "antiair", card->m_antiair);
+        c.m_armored = combat_value<uint8_t>(card, "armored", card->m_armored);
+        c.m_berserk = combat_value<uint8_t>(card, "berserk", card->m_berserk);
+        c.m_berserk_oa = combat_value<uint8_t>(card, "berserk (on attacked)", card->m_berserk_oa);
+        c.m_burst = combat_value<uint8_t>(card, "burst", card->m_burst);
+        c.m_counter = combat_value<uint8_t>(card, "counter", card->m_counter);
+        c.m_crush = combat_value<uint8_t>(card, "crush", card->m_crush);
+        c.m_flurry = combat_value<uint8_t>(card, "flurry", card->m_flurry);
+        c.m_leech = combat_value<uint8_t>(card, "leech", card->m_leech);
+        c.m_pierce = combat_value<uint8_t>(card, "pierce", card->m_pierce);
+        c.m_poison = combat_value<uint8_t>(card, "poison", card->m_poison);
+        c.m_poison_oa = combat_value<uint8_t>(card, "poison (on attacked)", card->m_poison_oa);
+        c.m_regenerate = combat_value<uint8_t>(card, "regenerate", card->m_regenerate);
+        c.m_siphon = combat_value<uint8_t>(card, "siphon", card->m_siphon);
+        c.m_valor = combat_value<uint8_t>(card, "valor", card->m_valor);
+        c.m_num_skills = combat_value<uint8_t>(card, "number of skills", card->m_skills.size());
+        c.m_num_skills_played = combat_value<uint8_t>(card, "number of skills (on played)", card->m_skills_played.size());
+        c.m_num_skills_died = combat_value<uint8_t>(card, "number of skills (on death)", card->m_skills_died.size());
+        c.m_num_skills_attacked = combat_value<uint8_t>(card, "number of skills (on attacked)", card->m_skills_attacked.size());
+        c.m_faction = card->m_faction;
+        c.m_type = card->m_type;
+        c.m_blitz = card->m_blitz;
+        c.m_disease = card->m_disease;
+        c.m_disease_oa = card->m_disease_oa;
+        c.m_evade = card->m_evade;
+        c.m_fear = card->m_fear;
+        c.m_flying = card->m_flying;
+        c.m_immobilize = card->m_immobilize;
+        c.m_intercept = card->m_intercept;
+        c.m_payback = card->m_payback;
+        c.m_recharge = card->m_recharge;
+        c.m_refresh = card->m_refresh;
+        c.m_split = card->m_split;
+        c.m_swipe = card->m_swipe;
+        c.m_tribute = card->m_tribute;
+        c.m_wall = card->m_wall;
+        c.m_features =
+            (c.m_antiair > 0 || c.m_burst > 0 || c.m_flying || c.m_valor > 0 ? attack_modifier_feature : 0) |
+            (c.m_berserk > 0 || c.m_berserk_oa > 0 || c.m_counter > 0 || c.m_crush > 0 || c.m_disease || c.m_disease_oa ||
+             c.m_immobilize || c.m_leech > 0 || c.m_poison > 0 || c.m_poison_oa > 0 || c.m_siphon > 0 || c.m_num_skills_attacked > 0 ? on_attack_feature : 0);
+        skill_specs += 2 * c.m_num_skills + c.m_num_skills_played + c.m_num_skills_died + c.m_num_skills_attacked;
+        combat_cards.push_back(c);
+        card->m_combat = &combat_cards.back();
+    }
+    for(SkillSpec& skill: combat_skills)
+    {
+        if(std::get<0>(skill) != summon) { continue; }
+        const unsigned id(std::get<1>(skill));
+        std::get<1>(skill) = id < cards_by_id.size() && cards_by_id[id] ? cards_by_id[id]->m_combat - combat_cards.data() : no_combat_card;
+    }
+    // A card has the features of the cards it can summon, transitively.
+    for(bool changed(true); changed; )
+    {
+        changed = false;
+        for(CombatCard& c: combat_cards)
+        {
+            for(const SkillSpec* skill(c.m_skill_specs); skill != c.skills_attacked().end(); ++skill)
+            {
+                if(std::get<0>(*skill) != summon || std::get<1>(*skill) == no_combat_card) { continue; }
+                const CombatCard& summoned(combat_cards[std::get<1>(*skill)]);
+                if((summoned.m_features & ~c.m_features) != 0)
+                {
+                    c.m_features |= summoned.m_features;
+                    changed = true;
+                }
+            }
+        }
+    }
 }
 //------------------------------------------------------------------------------
 void parse_file(const char* filename, std::vector<char>& buffer, xml_document<>& doc)
@@ -728,6 +1163,8 @@ void parse_file(const char* filename, std::vector<char>& buffer, xml_document<>&
 //------------------------------------------------------------------------------
 void read_cards(Cards& cards)
 {
+    assert(std::is_sorted(std::begin(skill_parsers), std::end(skill_parsers),
+        [](const SkillParser& a, const SkillParser& b) { return(strcmp(a.first, b.first) < 0); }));
     std::vector<char> buffer;
     xml_document<> doc;
     parse_file("cards.xml", buffer, doc);
@@ -741,12 +1178,13 @@ void read_cards(Cards& cards)
         if(strcmp(card->name(), "unit") == 0)
         {
             xml_node<>* id_node(card->first_node("id"));
-            int id(id_node ? atoi(id_node->value()) : -1);
+            if(!id_node) { continue; }
+            unsigned id(atoi(id_node->value()));
             // Replacement art card
             xml_node<>* replace_node(card->first_node("replace"));
             if(replace_node)
             {
-                cards.replace[id] = atoi(replace_node->value());
+                cards.add_replacement(id, atoi(replace_node->value()));
                 continue;
             }
             xml_node<>* name_node(card->first_node("name"));
@@ -788,108 +1226,7 @@ void read_cards(Cards& cards)
                 for(xml_node<>* skill = card->first_node("skill"); skill;
                     skill = skill->next_sibling("skill"))
                 {
-                    if(strcmp(skill->first_attribute("id")->value(), "antiair") == 0)
-                    { c->m_antiair = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "armored") == 0)
-                    { c->m_armored = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "augment") == 0)
-                    { handle_skill<augment>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "berserk") == 0)
-                    {
-                        bool attacked(skill->first_attribute("attacked"));
-                        if(attacked) { c->m_berserk_oa = atoi(skill->first_attribute("x")->value()); }
-                        else {c->m_berserk = atoi(skill->first_attribute("x")->value()); }
-                    }
-                    if(strcmp(skill->first_attribute("id")->value(), "blitz") == 0)
-                    { c->m_blitz = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "burst") == 0)
-                    { c->m_burst = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "counter") == 0)
-                    { c->m_counter = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "crush") == 0)
-                    { c->m_crush = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "disease") == 0)
-                    {
-                        bool attacked(skill->first_attribute("attacked"));
-                        if(attacked) { c->m_disease_oa = true; }
-                        else {c->m_disease = true; }
-                    }
-                    if(strcmp(skill->first_attribute("id")->value(), "evade") == 0)
-                    { c->m_evade = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "fear") == 0)
-                    { c->m_fear = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "flurry") == 0)
-                    { c->m_flurry = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "flying") == 0)
-                    { c->m_flying = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "immobilize") == 0)
-                    { c->m_immobilize = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "intercept") == 0)
-                    { c->m_intercept = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "leech") == 0)
-                    { c->m_leech = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "payback") == 0)
-                    { c->m_payback = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "pierce") == 0)
-                    { c->m_pierce = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "poison") == 0)
-                    {
-                        bool attacked(skill->first_attribute("attacked"));
-                        if(attacked) { c->m_poison_oa = atoi(skill->first_attribute("x")->value()); }
-                        else {c->m_poison = atoi(skill->first_attribute("x")->value()); }
-                    }
-                    if(strcmp(skill->first_attribute("id")->value(), "recharge") == 0)
-                    { c->m_recharge = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "refresh") == 0)
-                    { c->m_refresh = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "regenerate") == 0)
-                    { c->m_regenerate = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "siphon") == 0)
-                    { c->m_siphon = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "split") == 0)
-                    { c->m_split = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "swipe") == 0)
-                    { c->m_swipe = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "tribute") == 0)
-                    { c->m_tribute = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "valor") == 0)
-                    { c->m_valor = atoi(skill->first_attribute("x")->value()); }
-                    if(strcmp(skill->first_attribute("id")->value(), "wall") == 0)
-                    { c->m_wall = true; }
-                    if(strcmp(skill->first_attribute("id")->value(), "chaos") == 0)
-                    { handle_skill<chaos>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "cleanse") == 0)
-                    { handle_skill<cleanse>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "enfeeble") == 0)
-                    { handle_skill<enfeeble>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "freeze") == 0)
-                    { handle_skill<freeze>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "heal") == 0)
-                    { handle_skill<heal>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "infuse") == 0)
-                    { handle_skill<infuse>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "jam") == 0)
-                    { handle_skill<jam>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "mimic") == 0)
-                    { handle_skill<mimic>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "protect") == 0)
-                    { handle_skill<protect>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "rally") == 0)
-                    { handle_skill<rally>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "rush") == 0)
-                    { handle_skill<rush>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "shock") == 0)
-                    { handle_skill<shock>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "siege") == 0)
-                    { handle_skill<siege>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "strike") == 0)
-                    { handle_skill<strike>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "summon") == 0)
-                    { handle_skill<summon>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "supply") == 0)
-                    { handle_skill<supply>(skill, c); }
-                    if(strcmp(skill->first_attribute("id")->value(), "weaken") == 0)
-                    { handle_skill<weaken>(skill, c); }
+                    parse_skill(skill, c);
                 }
                 cards.cards.push_back(c);
             }
@@ -906,6 +1243,10 @@ void read_cards(Cards& cards)
 //---------------------- $30 Deck: a commander + a sequence of cards -----------
 // Can be shuffled.
 // Implementations: random player and raid decks, ordered player decks.
+// Recharge puts back at most one card per turn (the action card played):
+// the draw buffers are reserved for turn_limit cards more than the deck,
+// so that a battle never grows them.
+unsigned turn_limit{50};
 //------------------------------------------------------------------------------
 struct DeckIface
 {
@@ -926,15 +1267,27 @@ struct DeckIface
     virtual DeckIface* clone() const = 0;
     virtual const Card* get_commander() = 0;
     virtual const Card* next() = 0;
-    virtual void shuffle(std::mt19937& re) = 0;
+    virtual void shuffle(CounterRng& re) = 0;
     // Special case for recharge (behemoth raid's ability).
     virtual void place_at_bottom(const Card*) = 0;
+    // Back to the order of the last shuffle, to play the same draw again.
+    virtual void rewind() = 0;
+    // CombatFeature mask of all the cards the deck can play
+    virtual unsigned features() const
+    {
+        unsigned deck_features(commander->m_combat->m_features);
+        for(const Card* card: cards) { deck_features |= card->m_combat->m_features; }
+        return(deck_features);
+    }
 };
 //------------------------------------------------------------------------------
 struct DeckRandom : DeckIface
 {
     std::vector<std::pair<unsigned, std::vector<const Card*> > > raid_cards;
-    std::deque<const Card*> shuffled_cards;
+    // Drawn from draw_pos on. Cleared but not freed by shuffle.
+    std::vector<const Card*> shuffled_cards;
+    unsigned draw_pos{0};
+    unsigned shuffled_size{0}; // without the cards placed at the bottom since
 
     DeckRandom(
         const Card* commander_,
@@ -1027,11 +1380,9 @@ struct DeckRandom : DeckIface
 
     const Card* next()
     {
-        if(!shuffled_cards.empty())
+        if(draw_pos < shuffled_cards.size())
         {
-            const Card* card = shuffled_cards.front();
-            shuffled_cards.pop_front();
-            return(card);
+            return(shuffled_cards[draw_pos++]);
         }
         else
         {
@@ -1039,23 +1390,44 @@ struct DeckRandom : DeckIface
         }
     }
 
-    void shuffle(std::mt19937& re)
+    void shuffle(CounterRng& re)
     {
-        shuffled_cards.clear();
-        boost::insert(shuffled_cards, shuffled_cards.end(), cards);
+        shuffled_cards.assign(cards.begin(), cards.end());
+        draw_pos = 0;
         for(auto& card_pool: raid_cards)
         {
             assert(card_pool.first <= card_pool.second.size());
-            partial_shuffle(card_pool.second.begin(), card_pool.second.begin() + card_pool.first, card_pool.second.end(), re);
-            shuffled_cards.insert(shuffled_cards.end(), card_pool.second.begin(), card_pool.second.begin() + card_pool.first);
+            // Drawn from a copy of the pool, so that the draw only depends on re
+            const unsigned pool_begin(shuffled_cards.size());
+            shuffled_cards.insert(shuffled_cards.end(), card_pool.second.begin(), card_pool.second.end());
+            partial_shuffle(shuffled_cards.begin() + pool_begin, shuffled_cards.begin() + pool_begin + card_pool.first, shuffled_cards.end(), re);
+            shuffled_cards.erase(shuffled_cards.begin() + pool_begin + card_pool.first, shuffled_cards.end());
         }
         boost::shuffle(shuffled_cards, re);
+        shuffled_size = shuffled_cards.size();
+        shuffled_cards.reserve(shuffled_size + turn_limit);
+    }
+
+    void rewind()
+    {
+        shuffled_cards.resize(shuffled_size);
+        draw_pos = 0;
     }
 
     void place_at_bottom(const Card* card)
     {
         shuffled_cards.push_back(card);
     }
+
+    unsigned features() const
+    {
+        unsigned deck_features(DeckIface::features());
+        for(auto& card_pool: raid_cards)
+        {
+            for(const Card* card: card_pool.second) { deck_features |= card->m_combat->m_features; }
+        }
+        return(deck_features);
+    }
 };
 
 void print_deck(DeckIface& deck)
@@ -1076,15 +1448,23 @@ void print_deck(DeckIface& deck)
 }
 //------------------------------------------------------------------------------
 // No support for ordered raid decks
+const unsigned no_slot{std::numeric_limits<unsigned>::max()};
 struct DeckOrdered : DeckIface
 {
-    std::deque<const Card*> shuffled_cards;
-    // card id -> card order
-    std::map<unsigned, std::list<unsigned> > order;
+    // Slots (indices in cards) in shuffled order, drawn from draw_pos on.
+    std::vector<unsigned> shuffled_slots;
+    unsigned draw_pos{0};
+    // shuffled_slots as shuffled, before next() reorders them
+    std::vector<unsigned> initial_slots;
+    // The order of the cards: among the cards with the same id, the one in the
+    // lowest slot is played first. Per slot: the first and the next slot with the same id.
+    std::vector<unsigned> first_slot;
+    std::vector<unsigned> next_slot;
+    // Per first slot: the lowest slot of that id not played yet (no_slot: all played).
+    std::vector<unsigned> order_head;
 
     DeckOrdered(const Card* commander_, boost::any_range<const Card*, boost::forward_traversal_tag, const Card*, std::ptrdiff_t> cards_) :
-        DeckIface(commander_, cards_),
-        shuffled_cards(cards.begin(), cards.end())
+        DeckIface(commander_, cards_)
     {
     }
 
@@ -1102,90 +1482,146 @@ struct DeckOrdered : DeckIface
 
     const Card* get_commander() { return(commander); }
 
+    // Plays the card with the lowest order among the first 3 cards.
     const Card* next()
     {
-        if(shuffled_cards.empty())
+        if(draw_pos == shuffled_slots.size())
         {
             return(nullptr);
         }
-        else
-        {
-            auto cardIter = std::min_element(shuffled_cards.begin(), shuffled_cards.begin() + std::min<unsigned>(3u, shuffled_cards.size()), [this](const Card* card1, const Card* card2) -> bool
-                                             {
-                                                 auto card1_order = order.find(card1->m_id);
-                                                 if(!card1_order->second.empty())
-                                                 {
-                                                     auto card2_order = order.find(card2->m_id);
-                                                     if(!card1_order->second.empty())
-                                                     {
-                                                         return(*card1_order->second.begin() < *card2_order->second.begin());
-                                                     }
-                                                     else
-                                                     {
-                                                         return(true);
-                                                     }
-                                                 }
-                                                 else
-                                                 {
-                                                     return(false);
-                                                 }
-                                             });
-            auto card = *cardIter;
-            shuffled_cards.erase(cardIter);
-            auto card_order = order.find(card->m_id);
-            if(!card_order->second.empty())
+        auto drawable_begin = shuffled_slots.begin() + draw_pos;
+        auto drawable_end = drawable_begin + std::min<unsigned>(3u, shuffled_slots.size() - draw_pos);
+        auto slot_it = std::min_element(drawable_begin, drawable_end, [this](unsigned slot1, unsigned slot2) -> bool
             {
-                card_order->second.erase(card_order->second.begin());
-            }
-            return(card);
+                return(order_head[first_slot[slot1]] < order_head[first_slot[slot2]]);
+            });
+        std::rotate(drawable_begin, slot_it, slot_it + 1);
+        const unsigned slot(shuffled_slots[draw_pos++]);
+        unsigned& head(order_head[first_slot[slot]]);
+        if(head != no_slot)
+        {
+            head = next_slot[head];
         }
+        return(cards[slot]);
     }
 
-    void shuffle(std::mt19937& re)
+    void shuffle(CounterRng& re)
     {
-        unsigned i = 0;
-        order.clear();
-        for(auto card: cards)
+        const unsigned num_cards(cards.size());
+        first_slot.resize(num_cards);
+        next_slot.assign(num_cards, no_slot);
+        order_head.resize(num_cards);
+        for(unsigned slot(0); slot < num_cards; ++slot)
         {
-            order[card->m_id].push_back(i);
-            ++i;
+            first_slot[slot] = slot;
+            order_head[slot] = slot;
+            for(unsigned prev_slot(slot); prev_slot-- > 0; )
+            {
+                if(cards[prev_slot]->m_id == cards[slot]->m_id)
+                {
+                    first_slot[slot] = first_slot[prev_slot];
+                    next_slot[prev_slot] = slot;
+                    break;
+                }
+            }
         }
-        shuffled_cards.clear();
-        range::insert(shuffled_cards, shuffled_cards.end(), cards);
-        std::shuffle(shuffled_cards.begin(), shuffled_cards.end(), re);
+        shuffled_slots.reserve(num_cards + turn_limit);
+        shuffled_slots.resize(num_cards);
+        std::iota(shuffled_slots.begin(), shuffled_slots.end(), 0u);
+        std::shuffle(shuffled_slots.begin(), shuffled_slots.end(), re);
+        initial_slots = shuffled_slots;
+        draw_pos = 0;
+    }
+
+    void rewind()
+    {
+        shuffled_slots = initial_slots;
+        draw_pos = 0;
+        std::iota(order_head.begin(), order_head.end(), 0u);
     }
 
     void place_at_bottom(const Card* card)
     {
-        shuffled_cards.push_back(card);
+        auto card_it = std::find(cards.begin(), cards.end(), card);
+        assert(card_it != cards.end());
+        shuffled_slots.push_back(card_it - cards.begin());
     }
 };
 //------------------------------------------------------------------------------
 // Represents a particular draw from a deck.
 // Persistent object: call reset to get a new draw.
+// Summon and split stop at 100 cards per player, and at most one card is played per turn:
+// with the default turn limit, at most 100 + 50 cards per player.
+// Only a much higher -turnlimit could exceed max_cards_in_play; Storage then throws.
+const unsigned max_cards_in_play{256};
 class Hand
 {
 public:
 
     Hand(DeckIface* deck_) :
         deck(deck_),
-        assaults(15),
-        structures(15)
+        assaults(max_cards_in_play),
+        structures(max_cards_in_play)
     {
     }
 
-    void reset(std::mt19937& re)
+    void reset(CounterRng& re)
+    {
+        clear();
+        deck->shuffle(re);
+    }
+
+    // Same draw as the last reset
+    void rewind()
+    {
+        clear();
+        deck->rewind();
+    }
+
+    void clear()
     {
         assaults.reset();
         structures.reset();
-        commander = CardStatus(deck->get_commander());
-        deck->shuffle(re);
+        num_alive_assaults = 0;
+        first_wall = no_slot;
+        commander = CardStatus(deck->get_commander()->m_combat);
+    }
+
+    // To be called when an assault or a structure is placed with hp > 0, or comes back to life.
+    void add_alive(const CardStatus& status)
+    {
+        if(status.m_card->m_type == CardType::assault) { ++num_alive_assaults; }
+        else if(status.m_card->m_wall) { first_wall = std::min(first_wall, status.m_index); }
+    }
+
+    // To be called when the hp of an assault or a structure drop to 0.
+    void remove_alive(const CardStatus& status)
+    {
+        if(status.m_card->m_type == CardType::assault)
+        {
+            assert(num_alive_assaults > 0);
+            --num_alive_assaults;
+        }
+        else if(status.m_index == first_wall) { update_first_wall(first_wall + 1); }
+    }
+
+    // Looks for the first living wall from the index from on.
+    void update_first_wall(unsigned from)
+    {
+        for(first_wall = from; first_wall < structures.size(); ++first_wall)
+        {
+            const CardStatus& status(structures[first_wall]);
+            if(status.m_card->m_wall && status.m_hp > 0) { return; }
+        }
+        first_wall = no_slot;
     }
 
     DeckIface* deck;
     CardStatus commander;
     Storage<CardStatus> assaults;
     Storage<CardStatus> structures;
+    unsigned num_alive_assaults; // assaults with hp > 0
+    unsigned first_wall; // index in structures of the first wall with hp > 0, or no_slot
 };
 //---------------------- $40 Game rules implementation -------------------------
 // Everything about how a battle plays out, except the following:
@@ -1193,12 +1629,11 @@ public:
 // the implementation of the active skills is in the section after that.
 // struct Field is the data model of a battle:
 // an attacker and a defender deck, list of assaults and structures, etc.
-unsigned turn_limit{50};
 class Field
 {
 public:
     bool end;
-    std::mt19937& re;
+    CounterRng& re;
     const Cards& cards;
     // players[0]: the attacker, players[1]: the defender
     std::array<Hand*, 2> players;
@@ -1213,7 +1648,8 @@ public:
     gamemode_t gamemode;
     // With the introduction of on death skills, a single skill can trigger arbitrary many skills.
     // They are stored in this, and cleared after all have been performed.
-    std::deque<std::tuple<PlayedCard, SkillSpec> > skill_queue;
+    // At most a few skills per card in play.
+    RingDeque<std::tuple<PlayedCard, SkillSpec>, 1024> skill_queue;
     std::vector<CardStatus*> killed_with_on_death;
     std::vector<CardStatus*> killed_with_regen;
     enum phase
@@ -1229,25 +1665,62 @@ public:
     // Meaningless in playcard_phase,
     // otherwise is the index of the current card in players->structures or players->assaults
     unsigned current_ci;
+    // Coin tosses: the bits of one draw of re, used one at a time
+    uint64_t flip_bits;
+    unsigned num_flip_bits;
 
-    Field(std::mt19937& re_, const Cards& cards_, Hand& hand1, Hand& hand2, gamemode_t _gamemode) :
-        end{false},
+    Field(CounterRng& re_, const Cards& cards_, Hand& hand1, Hand& hand2, gamemode_t _gamemode) :
         re(re_),
         cards(cards_),
-        players{{&hand1, &hand2}},
-        turn(1),
         gamemode(_gamemode)
     {
+        killed_with_on_death.reserve(2 * max_cards_in_play);
+        killed_with_regen.reserve(2 * max_cards_in_play);
+        reset(hand1, hand2);
+    }
+
+    // Prepares a new battle between hand1 and hand2, keeping the memory of the previous one.
+    void reset(Hand& hand1, Hand& hand2)
+    {
+        end = false;
+        players = {{&hand1, &hand2}};
+        turn = 1;
+        skill_queue.clear();
+        killed_with_on_death.clear();
+        killed_with_regen.clear();
+        flip_bits = 0;
+        num_flip_bits = 0;
     }
 
+    // Uniform in [x, y]: multiply-shift of 32 random bits (Lemire), with rejection of
+    // the few values that would bias the result.
     inline unsigned rand(unsigned x, unsigned y)
     {
-        return(std::uniform_int_distribution<unsigned>(x, y)(re));
+        assert(x <= y && y - x < std::numeric_limits<uint32_t>::max());
+        const uint32_t range(y - x + 1);
+        uint64_t m(uint64_t(uint32_t(re())) * range);
+        if(uint32_t(m) < range)
+        {
+            const uint32_t threshold(uint32_t(-range) % range);
+            while(uint32_t(m) < threshold)
+            {
+                m = uint64_t(uint32_t(re())) * range;
+            }
+        }
+        return(x + (m >> 32));
     }
 
     inline unsigned flip()
     {
-        return(this->rand(0,1));
+        if(num_flip_bits == 0)
+        {
+            flip_bits = re();
+            num_flip_bits = 64;
+        }
+        const unsigned bit(flip_bits & 1);
+        flip_bits >>= 1;
+        --num_flip_bits;
+        return(bit);
     }
 
     template <typename T>
@@ -1276,7 +1749,7 @@ std::string played_card_description(Field* fd, const PlayedCard& pcard)
     case CardType::structure: desc = "Struct " + to_string(pcard.status->m_index) + " "; break;
     default: { assert(false); }
     }
-    desc += "[" + pcard.card->m_name + "]";
+    desc += "[" + pcard.card->m_source->m_name + "]";
     return(desc);
 }
 //------------------------------------------------------------------------------
@@ -1292,7 +1765,7 @@ std::string status_description(CardStatus* status)
     case CardType::structure: desc = "S " + to_string(status->m_index) + " "; break;
     default: { assert(false); }
     }
-    desc += "[" + status->m_card->m_name + "]";
+    desc += "[" + status->m_card->m_source->m_name + "]";
     return(desc);
 }
 //------------------------------------------------------------------------------
@@ -1305,7 +1778,7 @@ void prepend_on_death(Field* fd)
 {
     for(auto status: boost::adaptors::reverse(fd->killed_with_on_death))
     {
-        for(auto& skill: boost::adaptors::reverse(status->m_card->m_skills_died))
+        for(auto& skill: boost::adaptors::reverse(status->m_card->skills_died()))
         {
             _DEBUG_MSG("On death skill pushed in front %s %u %s\n", skill_names[std::get<0>(skill)].c_str(), std::get<1>(skill), faction_names[std::get<2>(skill)].c_str());
             fd->skill_queue.emplace_front(PlayedCard(status->m_card, status), skill);
@@ -1313,20 +1786,118 @@ void prepend_on_death(Field* fd)
     }
     fd->killed_with_on_death.clear();
 }
-//------------------------------------------------------------------------------
-void(*skill_table[num_skills])(Field*, const PlayedCard& origin, const SkillSpec& skill_spec);
-void resolve_skill(Field* fd)
+//---------------------- Profiling ---------------------------------------------
+// Build with -DPROFILE_BATTLES to count the calls and the cycles of each phase of the turns,
+// of each skill, of the attacks against each card type and of the target selection.
+// Cycles are inclusive: e.g. the attacks include the skills they trigger.
+// The structures and assaults phases count one call per card.
+// Each thread counts on its own; the counters are merged when the threads stop,
+// and printed at exit. Without PROFILE_BATTLES, the macros expand to nothing.
+#ifdef PROFILE_BATTLES
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+enum ProfilePhase
+{
+    turn_start_profile,
+    playcard_profile,
+    commander_profile,
+    structures_profile,
+    assaults_profile,
+    attack_profile,
+    target_selection_profile,
+    num_profile_phases
+};
+const char* profile_phase_names[num_profile_phases]{"turn start", "play card", "commander", "structures", "assaults", "attack phase", "target selection"};
+struct ProfileCounter
 {
-    while(!fd->skill_queue.empty())
+    uint64_t calls;
+    uint64_t cycles;
+};
+struct Profile
+{
+    ProfileCounter phases[num_profile_phases];
+    ProfileCounter skills[num_skills];
+    ProfileCounter attacks[CardType::num_cardtypes];
+
+    void merge(const Profile& other)
     {
-        auto skill_instance(fd->skill_queue.front());
-        auto& status(std::get<0>(skill_instance));
-        auto& skill(std::get<1>(skill_instance));
-        fd->skill_queue.pop_front();
-        skill_table[std::get<0>(skill)](fd, status, skill);
+        auto merge_counters = [](ProfileCounter* counters, const ProfileCounter* other_counters, unsigned size)
+        {
+            for(unsigned i(0); i < size; ++i)
+            {
+                counters[i].calls += other_counters[i].calls;
+                counters[i].cycles += other_counters[i].cycles;
+            }
+        };
+        merge_counters(phases, other.phases, num_profile_phases);
+        merge_counters(skills, other.skills, num_skills);
+        merge_counters(attacks, other.attacks, CardType::num_cardtypes);
+    }
+};
+thread_local Profile thread_profile;
+// Merged profile of the threads that have stopped, printed at exit.
+struct TotalProfile
+{
+    Profile profile;
+    boost::mutex mutex;
+
+    ~TotalProfile()
+    {
+        uint64_t battle_cycles(0);
+        for(unsigned phase(turn_start_profile); phase <= assaults_profile; ++phase) { battle_cycles += profile.phases[phase].cycles; }
+        if(battle_cycles == 0) { return; }
+        auto print_counter = [battle_cycles](const std::string& name, const ProfileCounter& counter)
+        {
+            if(counter.calls == 0) { return; }
+            std::cout << name << "\t" << counter.calls << "\t" << counter.cycles << "\t" << counter.cycles / counter.calls
+                      << "\t" << 100.0 * counter.cycles / battle_cycles << "\n";
+        };
+        std::cout << "#profile\tcalls\tcycles\tcycles/call\t%\n";
+        for(unsigned phase(0); phase < num_profile_phases; ++phase) { print_counter(profile_phase_names[phase], profile.phases[phase]); }
+        for(unsigned type(0); type < CardType::num_cardtypes; ++type) { print_counter("attack " + cardtype_names[type], profile.attacks[type]); }
+        for(unsigned skill(0); skill < num_skills; ++skill) { print_counter("skill " + skill_names[skill], profile.skills[skill]); }
+    }
+} total_profile;
+void merge_thread_profile()
+{
+    boost::lock_guard<boost::mutex> lock(total_profile.mutex);
+    total_profile.profile.merge(thread_profile);
+    thread_profile = Profile();
+}
+struct ProfileScope
+{
+    ProfileCounter& counter;
+    const uint64_t start;
+
+    ProfileScope(ProfileCounter& counter_) : counter(counter_), start(__rdtsc()) {}
+    ~ProfileScope()
+    {
+        ++counter.calls;
+        counter.cycles += __rdtsc() - start;
     }
+};
+template<typename F>
+inline auto profiled(ProfileCounter& counter, F f) -> decltype(f())
+{
+    ProfileScope scope(counter);
+    return(f());
 }
+// Profile the rest of the enclosing block
+#define PROFILE_SCOPE(counter) ProfileScope profile_scope(thread_profile.counter)
+// Profile the evaluation of an expression
+#define PROFILED(counter, ...) profiled(thread_profile.counter, [&]() { return(__VA_ARGS__); })
+#else
+#define PROFILE_SCOPE(counter)
+#define PROFILED(counter, ...) (__VA_ARGS__)
+#endif
+//------------------------------------------------------------------------------
+// Resolves the skills of the skill queue; defined after the skills implementation.
+void resolve_skill(Field* fd);
 //------------------------------------------------------------------------------
+template<unsigned features>
 void attack_phase(Field* fd);
 SkillSpec augmented_skill(const PlayedCard& origin, const SkillSpec& skill_spec)
 {
@@ -1338,7 +1909,7 @@ SkillSpec augmented_skill(const PlayedCard& origin, const SkillSpec& skill_spec)
     }
     return(augmented_skill_spec);
 }
-void evaluate_skills(Field* fd, const PlayedCard& origin, const std::vector<SkillSpec>& skills)
+void evaluate_skills(Field* fd, const PlayedCard& origin, SkillRange skills)
 {
     assert(fd->skill_queue.size() == 0);
     for(auto& skill: skills)
@@ -1349,12 +1920,12 @@ void evaluate_skills(Field* fd, const PlayedCard& origin, const std::vector<Skil
 }
 struct PlayCard
 {
-    const Card* card;
+    const CombatCard* card;
     Field* fd;
     CardStatus* status;
     Storage<CardStatus>* storage;
 
-    PlayCard(const Card* card_, Field* fd_) :
+    PlayCard(const CombatCard* card_, Field* fd_) :
         card{card_},
         fd{fd_},
         status{nullptr},
@@ -1384,6 +1955,7 @@ struct PlayCard
         status->set(card);
         status->m_index = storage->size() - 1;
         status->m_player = fd->tapi;
+        if(status->m_hp > 0) { fd->tap->add_alive(*status); }
         if(fd->turn == 1 && fd->gamemode == tournament && status->m_delay > 0)
         {
             ++status->m_delay;
@@ -1395,7 +1967,7 @@ struct PlayCard
     template <enum CardType::CardType type>
     void placeDebugMsg()
     {
-        _DEBUG_MSG("Placed [%s] as %s %d\n", card->m_name.c_str(), cardtype_names[type].c_str(), storage->size() - 1);
+        _DEBUG_MSG("Placed [%s] as %s %d\n", card->m_source->m_name.c_str(), cardtype_names[type].c_str(), storage->size() - 1);
     }
 
     // all except assault: noop
@@ -1408,7 +1980,7 @@ struct PlayCard
     template <enum CardType::CardType>
     void onPlaySkills()
     {
-        for(auto& skill: card->m_skills_played)
+        for(auto& skill: card->skills_played())
         {
             fd->skill_queue.emplace_back(PlayedCard(card, status), skill);
             resolve_skill(fd);
@@ -1445,7 +2017,7 @@ void PlayCard::blitz<CardType::assault>()
 template <>
 void PlayCard::onPlaySkills<CardType::action>()
 {
-    for(auto& skill: card->m_skills)
+    for(auto& skill: card->skills())
     {
         fd->skill_queue.emplace_back(PlayedCard(card, nullptr), skill);
         resolve_skill(fd);
@@ -1460,13 +2032,16 @@ void PlayCard::onPlaySkills<CardType::action>()
     // Special case: recharge ability
     if(card->m_recharge && fd->flip())
     {
-        fd->tap->deck->place_at_bottom(card);
+        fd->tap->deck->place_at_bottom(card->m_source);
     }
 }
 //------------------------------------------------------------------------------
+template<unsigned features>
 void turn_start_phase(Field* fd);
 void prepend_on_death(Field* fd);
 // return value : 0 -> attacker wins, 1 -> defender wins
+// features: CombatFeature mask of the abilities of both decks
+template<unsigned features>
 unsigned play(Field* fd)
 {
     fd->players[0]->commander.m_player = 0;
@@ -1482,16 +2057,18 @@ unsigned play(Field* fd)
         fd->current_phase = Field::playcard_phase;
         // Initialize stuff, remove dead cards
         _DEBUG_MSG("##### TURN %u #####\n", fd->turn);
-        turn_start_phase(fd);
+        PROFILED(phases[turn_start_profile], turn_start_phase<features>(fd));
         // Special case: refresh on commander
         if(fd->tip->commander.m_card->m_refresh && fd->tip->commander.m_hp > 0)
         {
             fd->tip->commander.m_hp = fd->tip->commander.m_card->m_health;
         }
         // Play a card
-        const Card* played_card(fd->tap->deck->next());
+        const Card* next_card(fd->tap->deck->next());
+        const CombatCard* played_card(next_card ? next_card->m_combat : nullptr);
         if(played_card)
         {
+            PROFILE_SCOPE(phases[playcard_profile]);
             switch(played_card->m_type)
             {
             case CardType::action:
@@ -1509,26 +2086,28 @@ unsigned play(Field* fd)
         }
         // Evaluate commander
         fd->current_phase = Field::commander_phase;
-        evaluate_skills(fd, PlayedCard(fd->tap->commander.m_card, &fd->tap->commander), fd->tap->commander.m_card->m_skills);
+        PROFILED(phases[commander_profile], evaluate_skills(fd, PlayedCard(fd->tap->commander.m_card, &fd->tap->commander), fd->tap->commander.m_card->skills()));
         // Evaluate structures
         fd->current_phase = Field::structures_phase;
         for(fd->current_ci = 0; !fd->end && fd->current_ci < fd->tap->structures.size(); ++fd->current_ci)
         {
+            PROFILE_SCOPE(phases[structures_profile]);
             CardStatus& current_status(fd->tap->structures[fd->current_ci]);
             if(current_status.m_delay == 0)
             {
-                evaluate_skills(fd, PlayedCard(current_status.m_card, &current_status), current_status.m_card->m_skills);
+                evaluate_skills(fd, PlayedCard(current_status.m_card, &current_status), current_status.m_card->skills());
             }
         }
         // Evaluate assaults
         fd->current_phase = Field::assaults_phase;
         for(fd->current_ci = 0; !fd->end && fd->current_ci < fd->tap->assaults.size(); ++fd->current_ci)
         {
+            PROFILE_SCOPE(phases[assaults_profile]);
             // ca: current assault
             CardStatus& current_status(fd->tap->assaults[fd->current_ci]);
             if((current_status.m_delay > 0 && !current_status.blitz) || current_status.m_hp == 0 || current_status.m_jammed || current_status.m_frozen)
             {
-                //_DEBUG_MSG("! Assault %u (%s) hp: %u, jammed %u\n", card_index, current_status.m_card->m_name.c_str(), current_status.m_hp, current_status.m_jammed);
+                //_DEBUG_MSG("! Assault %u (%s) hp: %u, jammed %u\n", card_index, current_status.m_card->m_source->m_name.c_str(), current_status.m_hp, current_status.m_jammed);
             }
             else
             {
@@ -1537,15 +2116,18 @@ unsigned play(Field* fd)
                 {
                     CardStatus& status_split(fd->tap->assaults.add_back());
                     status_split.set(current_status.m_card);
-                    _DEBUG_MSG("Split assault %d (%s)\n", fd->tap->assaults.size() - 1, current_status.m_card->m_name.c_str());
+                    status_split.m_index = fd->tap->assaults.size() - 1;
+                    status_split.m_player = fd->tapi;
+                    if(status_split.m_hp > 0) { fd->tap->add_alive(status_split); }
+                    _DEBUG_MSG("Split assault %d (%s)\n", fd->tap->assaults.size() - 1, current_status.m_card->m_source->m_name.c_str());
                 }
                 // Evaluate skills
                 // Special case: Gore Typhon's infuse
-                evaluate_skills(fd, PlayedCard(current_status.m_card, &current_status), current_status.m_infused ? current_status.infused_skills : current_status.m_card->m_skills);
+                evaluate_skills(fd, PlayedCard(current_status.m_card, &current_status), current_status.m_infused ? current_status.m_card->skills_infused() : current_status.m_card->skills());
                 // Attack
                 if(!current_status.m_immobilized && current_status.m_hp > 0)
                 {
-                    attack_phase(fd);
+                    attack_phase<features>(fd);
                 }
             }
         }
@@ -1557,7 +2139,18 @@ unsigned play(Field* fd)
     if(fd->players[0]->commander.m_hp == 0) { _DEBUG_MSG("Defender wins.\n"); return(1); }
     // attacker wins
     if(fd->players[1]->commander.m_hp == 0) { _DEBUG_MSG("Attacker wins.\n"); return(0); }
-    if(fd->turn >= turn_limit) { return(1); }
+    // turn limit reached: the defender wins
+    return(1);
+}
+unsigned play(Field* fd, unsigned features)
+{
+    switch(features)
+    {
+    case 0: return(play<0>(fd));
+    case attack_modifier_feature: return(play<attack_modifier_feature>(fd));
+    case on_attack_feature: return(play<on_attack_feature>(fd));
+    default: return(play<all_features>(fd));
+    }
 }
 //------------------------------------------------------------------------------
 // All the stuff that happens at the beginning of a turn, before a card is played
@@ -1573,8 +2166,9 @@ bool remove_hp(Field* fd, CardStatus& status, unsigned dmg)
     const bool just_died(status.m_hp == 0);
     if(just_died)
     {
-        _DEBUG_MSG("Card %u (%s) dead\n", status.m_index, status.m_card->m_name.c_str());
-        if(status.m_card->m_skills_died.size() > 0)
+        _DEBUG_MSG("Card %u (%s) dead\n", status.m_index, status.m_card->m_source->m_name.c_str());
+        fd->players[status.m_player]->remove_alive(status);
+        if(status.m_card->skills_died().size() > 0)
         {
             fd->killed_with_on_death.push_back(&status);
         }
@@ -1606,21 +2200,26 @@ void check_regeneration(Field* fd)
         if(status.m_hp == 0 && status.m_card->m_regenerate > 0 && !status.m_diseased)
         {
             status.m_hp = fd->flip() ? status.m_card->m_regenerate : 0;
-        }
-        if(status.m_hp > 0)
-        {
-            _DEBUG_MSG("Card %s regenerated, hp 0 -> %u\n", status.m_card->m_name.c_str(), status.m_hp);
+            if(status.m_hp > 0)
+            {
+                _DEBUG_MSG("Card %s regenerated, hp 0 -> %u\n", status.m_card->m_source->m_name.c_str(), status.m_hp);
+                fd->players[status.m_player]->add_alive(status);
+            }
         }
 
     }
     fd->killed_with_regen.clear();
 }
+template<unsigned features>
 void turn_start_phase(Field* fd)
 {
     remove_dead(fd->tap->assaults);
     remove_dead(fd->tap->structures);
     remove_dead(fd->tip->assaults);
     remove_dead(fd->tip->structures);
+    // The indices have changed
+    fd->tap->update_first_wall(0);
+    fd->tip->update_first_wall(0);
     // Active player's assault cards:
     // update index
     // remove enfeeble, protect; apply poison damage, reduce delay
@@ -1634,7 +2233,7 @@ void turn_start_phase(Field* fd)
             status.m_index = index;
             status.m_enfeebled = 0;
             status.m_protected = 0;
-            remove_hp(fd, status, status.m_poisoned);
+            if(features & on_attack_feature) { remove_hp(fd, status, status.m_poisoned); }
             if(status.m_delay > 0 && !status.m_frozen) { --status.m_delay; }
         }
     }
@@ -1712,7 +2311,7 @@ void turn_start_phase(Field* fd)
 //---------------------- $50 attack by assault card implementation -------------
 inline void add_hp(CardStatus* target, unsigned v)
 {
-    target->m_hp = std::min(target->m_hp + v, target->m_card->m_health);
+    target->m_hp = std::min<unsigned>(target->m_hp + v, target->m_card->m_health);
 }
 inline void apply_poison(CardStatus* target, unsigned v)
 {
@@ -1732,51 +2331,38 @@ inline unsigned counter_damage(CardStatus* att, CardStatus* def)
 }
 inline CardStatus* select_first_enemy_wall(Field* fd)
 {
-    for(unsigned i(0); i < fd->tip->structures.size(); ++i)
-    {
-        CardStatus& card(fd->tip->structures[i]);
-        if(card.m_card->m_wall && card.m_hp > 0) { return(&card); }
-    }
-    return(nullptr);
+    return(fd->tip->first_wall == no_slot ? nullptr : &fd->tip->structures[fd->tip->first_wall]);
 }
 
 inline unsigned valor_damage(Field* fd, CardStatus& status)
 {
-    if(status.m_card->m_valor > 0)
+    if(status.m_card->m_valor > 0 && fd->tap->num_alive_assaults < fd->tip->num_alive_assaults)
     {
-        unsigned count_ta(0);
-        unsigned count_td(0);
-        for(unsigned i(0); i < fd->tap->assaults.size(); ++i)
-        {
-            if(fd->tap->assaults[i].m_hp > 0) { ++count_ta; }
-        }
-        for(unsigned i(0); i < fd->tip->assaults.size(); ++i)
-        {
-            if(fd->tip->assaults[i].m_hp > 0) { ++count_td; }
-        }
-        if(count_ta < count_td) { return(status.m_card->m_valor); }
+        return(status.m_card->m_valor);
     }
     return(0);
 }
 
+template<unsigned features>
 inline unsigned attack_damage_against_non_assault(Field* fd, CardStatus& att_status)
 {
-    const Card& att_card(*att_status.m_card);
+    const CombatCard& att_card(*att_status.m_card);
     assert(att_card.m_type == CardType::assault);
     // pre modifier damage
     unsigned damage(attack_power(&att_status));
     //
-    if(damage > 0)
+    if(damage > 0 && (features & attack_modifier_feature))
     {
         damage += valor_damage(fd, att_status);
     }
     return(damage);
 }
 
+template<unsigned features>
 inline unsigned attack_damage_against_assault(Field* fd, CardStatus& att_status, CardStatus& def_status)
 {
-    const Card& att_card(*att_status.m_card);
-    const Card& def_card(*def_status.m_card);
+    const CombatCard& att_card(*att_status.m_card);
+    const CombatCard& def_card(*def_status.m_card);
     assert(att_card.m_type == CardType::assault);
     assert(def_card.m_type == CardType::assault);
     // pre modifier damage
@@ -1784,12 +2370,15 @@ inline unsigned attack_damage_against_assault(Field* fd, CardStatus& att_status,
     //
     if(damage > 0)
     {
+        if(features & attack_modifier_feature)
+        {
+            damage += valor_damage(fd, att_status) // valor
+                + (def_card.m_flying ? att_card.m_antiair : 0) // anti-air
+                + (att_card.m_burst > 0 ? (def_status.m_hp == def_card.m_health ? att_card.m_burst : 0) : 0); // burst
+        }
         damage = safe_minus(
             damage // pre-modifier damage
-            + valor_damage(fd, att_status) // valor
             + def_status.m_enfeebled // enfeeble
-            + (def_card.m_flying ? att_card.m_antiair : 0) // anti-air
-            + (att_card.m_burst > 0 ? (def_status.m_hp == def_card.m_health ? att_card.m_burst : 0) : 0) // burst
             // armor + protect + pierce
             , safe_minus(def_card.m_armored + def_status.m_protected, att_card.m_pierce));
     }
@@ -1823,12 +2412,14 @@ struct PerformAttack
         fd(fd_), att_status(att_status_), def_status(def_status_), att_dmg(0), killed_by_attack(false)
     {}
 
-    template<enum CardType::CardType cardtype>
+    // features: the abilities that are checked (see CombatFeature)
+    template<unsigned features, enum CardType::CardType cardtype>
     void op()
     {
+        PROFILE_SCOPE(attacks[cardtype]);
         if(attack_power(att_status) > 0)
         {
-            const bool fly_check(!def_status->m_card->m_flying || att_status->m_card->m_flying || att_status->m_card->m_antiair > 0 || fd->flip());
+            const bool fly_check(!(features & attack_modifier_feature) || !def_status->m_card->m_flying || att_status->m_card->m_flying || att_status->m_card->m_antiair > 0 || fd->flip());
             if(fly_check) // unnecessary check for structures, commander -> fix later ?
             {
                 // Evaluation order:
@@ -1840,15 +2431,17 @@ struct PerformAttack
                 // counter, berserk
                 // assaults only: (crush, leech if still alive)
                 // check regeneration
-                att_dmg = calculate_attack_damage<cardtype>();
+                att_dmg = cardtype == CardType::assault ?
+                    attack_damage_against_assault<features>(fd, *att_status, *def_status) :
+                    attack_damage_against_non_assault<features>(fd, *att_status);
                 if(att_dmg > 0)
                 {
-                    immobilize<cardtype>();
+                    if(features & on_attack_feature) { immobilize<cardtype>(); }
                     attack_damage<cardtype>();
-                    siphon_poison_disease<cardtype>();
+                    if(features & on_attack_feature) { siphon_poison_disease<cardtype>(); }
                 }
-                oa<cardtype>();
-                if(att_dmg > 0)
+                if(features & on_attack_feature) { oa<cardtype>(); }
+                if(att_dmg > 0 && (features & on_attack_feature))
                 {
                     if(att_status->m_hp > 0)
                     {
@@ -1863,12 +2456,6 @@ struct PerformAttack
         }
     }
 
-    template<enum CardType::CardType>
-    unsigned calculate_attack_damage()
-    {
-        return(attack_damage_against_non_assault(fd, *att_status));
-    }
-
     template<enum CardType::CardType>
     void immobilize() {}
 
@@ -1895,7 +2482,7 @@ struct PerformAttack
             att_status->m_diseased = true;
         }
         oa_berserk<cardtype>();
-        for(auto& oa_skill: def_status->m_card->m_skills_attacked)
+        for(auto& oa_skill: def_status->m_card->skills_attacked())
         {
             fd->skill_queue.emplace_back(PlayedCard(def_status->m_card, def_status), oa_skill);
             resolve_skill(fd);
@@ -1921,12 +2508,6 @@ struct PerformAttack
     void crush_leech() {}
 };
 
-template<>
-unsigned PerformAttack::calculate_attack_damage<CardType::assault>()
-{
-    return(attack_damage_against_assault(fd, *att_status, *def_status));
-}
-
 template<>
 void PerformAttack::immobilize<CardType::assault>()
 {
@@ -1948,8 +2529,8 @@ void PerformAttack::siphon_poison_disease<CardType::assault>()
 {
     if(att_status->m_card->m_siphon > 0)
     {
-        add_hp(&fd->tap->commander, std::min(att_dmg, att_status->m_card->m_siphon));
-        _DEBUG_MSG(" \033[1;32m%s siphon %u; hp %u\033[0m\n", status_description(att_status).c_str(), std::min(att_dmg, att_status->m_card->m_siphon), fd->tap->commander.m_hp);
+        add_hp(&fd->tap->commander, std::min<unsigned>(att_dmg, att_status->m_card->m_siphon));
+        _DEBUG_MSG(" \033[1;32m%s siphon %u; hp %u\033[0m\n", status_description(att_status).c_str(), std::min<unsigned>(att_dmg, att_status->m_card->m_siphon), fd->tap->commander.m_hp);
     }
     if(att_status->m_card->m_poison > 0)
     {
@@ -1983,14 +2564,16 @@ void PerformAttack::crush_leech<CardType::assault>()
     }
     if(att_status->m_card->m_leech > 0 && att_status->m_hp > 0 && !att_status->m_diseased)
     {
-        add_hp(att_status, std::min(att_dmg, att_status->m_card->m_leech));
-        _DEBUG_MSG("%s leech %u; hp: %u.\n", status_description(att_status).c_str(), std::min(att_dmg, att_status->m_card->m_leech), att_status->m_hp);
+        add_hp(att_status, std::min<unsigned>(att_dmg, att_status->m_card->m_leech));
+        _DEBUG_MSG("%s leech %u; hp: %u.\n", status_description(att_status).c_str(), std::min<unsigned>(att_dmg, att_status->m_card->m_leech), att_status->m_hp);
     }
 }
 
 // General attack phase by the currently evaluated assault, taking into accounts exotic stuff such as flurry,swipe,etc.
+template<unsigned features>
 void attack_phase(Field* fd)
 {
+    PROFILE_SCOPE(phases[attack_profile]);
     CardStatus* att_status(&fd->tap->assaults[fd->current_ci]); // attacking card
     Storage<CardStatus>& def_assaults(fd->tip->assaults);
     unsigned num_attacks(att_status->m_card->m_flurry > 0 && fd->flip() ? att_status->m_card->m_flurry + 1 : 1);
@@ -2006,7 +2589,7 @@ void attack_phase(Field* fd)
             // attack mode 1.
             if(!att_status->m_card->m_swipe)
             {
-                PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci]}.op<CardType::assault>();
+                PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci]}.op<features, CardType::assault>();
             }
             // attack mode 2.
             else
@@ -2014,17 +2597,17 @@ void attack_phase(Field* fd)
                 // attack the card on the left
                 if(alive_assault(def_assaults, fd->current_ci - 1))
                 {
-                    PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci-1]}.op<CardType::assault>();
+                    PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci-1]}.op<features, CardType::assault>();
                 }
                 // stille alive? attack the card in front
                 if(fd->tip->commander.m_hp > 0 && att_status->m_hp > 0 && alive_assault(def_assaults, fd->current_ci))
                 {
-                    PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci]}.op<CardType::assault>();
+                    PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci]}.op<features, CardType::assault>();
                 }
                 // still alive? attack the card on the right
                 if(fd->tip->commander.m_hp > 0 && att_status->m_hp > 0 && alive_assault(def_assaults, fd->current_ci + 1))
                 {
-                    PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci+1]}.op<CardType::assault>();
+                    PerformAttack{fd, att_status, &fd->tip->assaults[fd->current_ci+1]}.op<features, CardType::assault>();
                 }
             }
         }
@@ -2034,11 +2617,11 @@ void attack_phase(Field* fd)
             CardStatus* def_status{select_first_enemy_wall(fd)}; // defending wall
             if(def_status != nullptr)
             {
-                PerformAttack{fd, att_status, def_status}.op<CardType::structure>();
+                PerformAttack{fd, att_status, def_status}.op<features, CardType::structure>();
             }
             else
             {
-                PerformAttack{fd, att_status, &fd->tip->commander}.op<CardType::commander>();
+                PerformAttack{fd, att_status, &fd->tip->commander}.op<features, CardType::commander>();
             }
         }
     }
@@ -2078,7 +2661,7 @@ inline bool skill_predicate<augment>(CardStatus* c)
 {
     if((c->m_delay == 0 || c->blitz) && c->m_hp > 0 && !c->m_jammed && !c->m_frozen)
     {
-        for(auto& s: c->m_card->m_skills)
+        for(auto& s: c->m_card->skills())
         {
             // Any quantifiable skill except augment
             if(std::get<1>(s) > 0 && std::get<0>(s) != augment && std::get<0>(s) != augment_all && std::get<0>(s) != summon) { return(true); }
@@ -2207,11 +2790,6 @@ inline void perform_skill<infuse>(Field* fd, CardStatus* c, unsigned v)
 {
     c->m_faction = bloodthirsty;
     c->m_infused = true;
-    c->infused_skills.clear();
-    for(auto skill: c->m_card->m_skills)
-    {
-        c->infused_skills.emplace_back(std::get<0>(skill), std::get<1>(skill), std::get<2>(skill) == allfactions ? allfactions : bloodthirsty);
-    }
 }
 
 template<>
@@ -2270,29 +2848,31 @@ inline void perform_skill<weaken>(Field* fd, CardStatus* c, unsigned v)
     c->m_weakened += v;
 }
 
+// Fills selection_array with the cards from first on that satisfy skill_predicate<skill_id>,
+// and returns their number.
 template<unsigned skill_id>
-inline unsigned select_fast(Field* fd, CardStatus* src_status, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_valid_targets(Field* fd, Storage<CardStatus>& cards, const SkillSpec& s, unsigned first = 0)
 {
     unsigned array_head{0};
     if(std::get<2>(s) == allfactions)
     {
-        for(auto card: cards)
+        for(unsigned card_index(first); card_index < cards.size(); ++card_index)
         {
-            if(skill_predicate<skill_id>(card))
+            if(skill_predicate<skill_id>(&cards[card_index]))
             {
-                fd->selection_array[array_head] = card;
+                fd->selection_array[array_head] = &cards[card_index];
                 ++array_head;
             }
         }
     }
     else
     {
-        for(auto card: cards)
+        for(unsigned card_index(first); card_index < cards.size(); ++card_index)
         {
-            if(card->m_faction == std::get<2>(s) &&
-               skill_predicate<skill_id>(card))
+            if(cards[card_index].m_faction == std::get<2>(s) &&
+               skill_predicate<skill_id>(&cards[card_index]))
             {
-                fd->selection_array[array_head] = card;
+                fd->selection_array[array_head] = &cards[card_index];
                 ++array_head;
             }
         }
@@ -2301,80 +2881,31 @@ inline unsigned select_fast(Field* fd, CardStatus* src_status, const std::vector
 }
 
 template<unsigned skill_id>
-inline unsigned fill_valid_targets_array(Field* fd, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast(Field* fd, CardStatus* src_status, Storage<CardStatus>& cards, const SkillSpec& s)
 {
-    unsigned array_head = 0;
-    if(std::get<2>(s) == allfactions)
-    {
-        for(auto card: cards)
-        {
-            if(skill_predicate<skill_id>(card))
-            {
-                fd->selection_array[array_head] = card;
-                ++array_head;
-            }
-        }
-    }
-    else
-    {
-        for(auto card: cards)
-        {
-            if(card->m_faction == std::get<2>(s) &&
-               skill_predicate<skill_id>(card))
-            {
-                fd->selection_array[array_head] = card;
-                ++array_head;
-            }
-        }
-    }
-    return(array_head);
+    return(select_valid_targets<skill_id>(fd, cards, s));
 }
 
 template<unsigned skill_id>
-inline unsigned select_rally_like(Field* fd, CardStatus* src_status, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_rally_like(Field* fd, CardStatus* src_status, Storage<CardStatus>& cards, const SkillSpec& s)
 {
-    unsigned array_head{0};
-    unsigned card_index(fd->current_phase == Field::assaults_phase ? fd->current_ci : 0);
-    if(std::get<2>(s) == allfactions)
-    {
-        for(; card_index < cards.size(); ++card_index)
-        {
-            if(skill_predicate<skill_id>(cards[card_index]))
-            {
-                fd->selection_array[array_head] = cards[card_index];
-                ++array_head;
-            }
-        }
-    }
-    else
-    {
-        for(; card_index < cards.size(); ++card_index)
-        {
-            if(cards[card_index]->m_faction == std::get<2>(s) &&
-               skill_predicate<skill_id>(cards[card_index]))
-            {
-                fd->selection_array[array_head] = cards[card_index];
-                ++array_head;
-            }
-        }
-    }
-    return(array_head);
+    return(select_valid_targets<skill_id>(fd, cards, s, fd->current_phase == Field::assaults_phase ? fd->current_ci : 0));
 }
 
 template<>
-inline unsigned select_fast<augment>(Field* fd, CardStatus* src_status, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast<augment>(Field* fd, CardStatus* src_status, Storage<CardStatus>& cards, const SkillSpec& s)
 {
     return(select_rally_like<augment>(fd, src_status, cards, s));
 }
 
 template<>
-inline unsigned select_fast<rally>(Field* fd, CardStatus* src_status, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast<rally>(Field* fd, CardStatus* src_status, Storage<CardStatus>& cards, const SkillSpec& s)
 {
     return(select_rally_like<rally>(fd, src_status, cards, s));
 }
 
 template<>
-inline unsigned select_fast<supply>(Field* fd, CardStatus* src_status, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast<supply>(Field* fd, CardStatus* src_status, Storage<CardStatus>& cards, const SkillSpec& s)
 {
     // mimiced supply by a structure, etc ?
     if(!(src_status && src_status->m_card->m_type == CardType::assault)) { return(0); }
@@ -2383,9 +2914,9 @@ inline unsigned select_fast<supply>(Field* fd, CardStatus* src_status, const std
     const unsigned max_index(src_status->m_index + (src_status->m_index == cards.size() - 1 ? 0 : 1));
     for(unsigned card_index(min_index); card_index <= max_index; ++card_index)
     {
-        if(skill_predicate<supply>(cards[card_index]))
+        if(skill_predicate<supply>(&cards[card_index]))
         {
-            fd->selection_array[array_head] = cards[card_index];
+            fd->selection_array[array_head] = &cards[card_index];
             ++array_head;
         }
     }
@@ -2396,120 +2927,120 @@ inline unsigned select_infuse(Field* fd, const SkillSpec& s)
 {
     unsigned array_head{0};
     // Select candidates among attacker's assaults
-    for(auto card_status: fd->tap->assaults.m_indirect)
+    for(auto& card_status: fd->tap->assaults)
     {
-        if(skill_predicate<infuse>(card_status))
+        if(skill_predicate<infuse>(&card_status))
         {
-            fd->selection_array[array_head] = card_status;
+            fd->selection_array[array_head] = &card_status;
             ++array_head;
         }
     }
     // Select candidates among defender's assaults
-    for(auto card_status: fd->tip->assaults.m_indirect)
+    for(auto& card_status: fd->tip->assaults)
     {
-        if(skill_predicate<infuse>(card_status))
+        if(skill_predicate<infuse>(&card_status))
         {
-            fd->selection_array[array_head] = card_status;
+            fd->selection_array[array_head] = &card_status;
             ++array_head;
         }
     }
     return(array_head);
 }
 
-inline std::vector<CardStatus*>& skill_targets_hostile_assault(Field* fd, CardStatus* src_status)
+inline Storage<CardStatus>& skill_targets_hostile_assault(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status ? (src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)) : fd->tipi]->assaults.m_indirect);
+    return(fd->players[src_status ? (src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)) : fd->tipi]->assaults);
 }
 
-inline std::vector<CardStatus*>& skill_targets_allied_assault(Field* fd, CardStatus* src_status)
+inline Storage<CardStatus>& skill_targets_allied_assault(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status ? src_status->m_player : fd->tapi]->assaults.m_indirect);
+    return(fd->players[src_status ? src_status->m_player : fd->tapi]->assaults);
 }
 
-inline std::vector<CardStatus*>& skill_targets_hostile_structure(Field* fd, CardStatus* src_status)
+inline Storage<CardStatus>& skill_targets_hostile_structure(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status ? (src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)) : fd->tipi]->structures.m_indirect);
+    return(fd->players[src_status ? (src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)) : fd->tipi]->structures);
 }
 
-inline std::vector<CardStatus*>& skill_targets_allied_structure(Field* fd, CardStatus* src_status)
+inline Storage<CardStatus>& skill_targets_allied_structure(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status ? src_status->m_player : fd->tapi]->structures.m_indirect);
+    return(fd->players[src_status ? src_status->m_player : fd->tapi]->structures);
 }
 
 template<unsigned skill>
-std::vector<CardStatus*>& skill_targets(Field* fd, CardStatus* src_status)
+Storage<CardStatus>& skill_targets(Field* fd, CardStatus* src_status)
 {
     std::cout << "skill_targets: Error: no specialization for " << skill_names[skill] << "\n";
     assert(false);
 }
 
 template<typename TargetsWho, typename TargetsWhat>
-std::vector<CardStatus*>& skill_target_by_action(Field* fd)
+Storage<CardStatus>& skill_target_by_action(Field* fd)
 {
     assert(false);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_action<true_, TargetsAssaults>(Field* fd)
+template<> Storage<CardStatus>& skill_target_by_action<true_, TargetsAssaults>(Field* fd)
 {
-    return(fd->tap->assaults.m_indirect);
+    return(fd->tap->assaults);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_action<false_, TargetsAssaults>(Field* fd)
+template<> Storage<CardStatus>& skill_target_by_action<false_, TargetsAssaults>(Field* fd)
 {
-    return(fd->tip->assaults.m_indirect);
+    return(fd->tip->assaults);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_action<true_, TargetsStructures>(Field* fd)
+template<> Storage<CardStatus>& skill_target_by_action<true_, TargetsStructures>(Field* fd)
 {
-    return(fd->tap->structures.m_indirect);
+    return(fd->tap->structures);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_action<false_, TargetsStructures>(Field* fd)
+template<> Storage<CardStatus>& skill_target_by_action<false_, TargetsStructures>(Field* fd)
 {
-    return(fd->tip->structures.m_indirect);
+    return(fd->tip->structures);
 }
 
 template<unsigned skill_id>
-std::vector<CardStatus*>& skill_targets_by_action(Field* fd)
+Storage<CardStatus>& skill_targets_by_action(Field* fd)
 {
     
     return(skill_target_by_action<typename SkillTraits<skill_id>::TargetsWho, typename SkillTraits<skill_id>::TargetsWhat>(fd));
 }
 
 template<typename TargetsWho, typename TargetsWhat>
-std::vector<CardStatus*>& skill_target_by_assault(Field* fd, CardStatus* src_status)
+Storage<CardStatus>& skill_target_by_assault(Field* fd, CardStatus* src_status)
 {
     assert(false);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_assault<true_, TargetsAssaults>(Field* fd, CardStatus* src_status)
+template<> Storage<CardStatus>& skill_target_by_assault<true_, TargetsAssaults>(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status->m_player]->assaults.m_indirect);
+    return(fd->players[src_status->m_player]->assaults);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_assault<false_, TargetsAssaults>(Field* fd, CardStatus* src_status)
+template<> Storage<CardStatus>& skill_target_by_assault<false_, TargetsAssaults>(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)]->assaults.m_indirect);
+    return(fd->players[src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)]->assaults);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_assault<true_, TargetsStructures>(Field* fd, CardStatus* src_status)
+template<> Storage<CardStatus>& skill_target_by_assault<true_, TargetsStructures>(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status->m_player]->structures.m_indirect);
+    return(fd->players[src_status->m_player]->structures);
 }
 
-template<> std::vector<CardStatus*>& skill_target_by_assault<false_, TargetsStructures>(Field* fd, CardStatus* src_status)
+template<> Storage<CardStatus>& skill_target_by_assault<false_, TargetsStructures>(Field* fd, CardStatus* src_status)
 {
-    return(fd->players[src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)]->structures.m_indirect);
+    return(fd->players[src_status->m_chaos ? src_status->m_player : opponent(src_status->m_player)]->structures);
 }
 
 template<unsigned skill>
-std::vector<CardStatus*>& skill_targets_bis(Field* fd, CardStatus* src_status)
+Storage<CardStatus>& skill_targets_bis(Field* fd, CardStatus* src_status)
 {
     return(skill_target_by_assault<typename SkillTraits<skill>::TargetsWho, typename SkillTraits<skill>::TargetsWhat>(fd, src_status));
 }
 
 template<unsigned skill_id>
-std::vector<CardStatus*>& get_potential_targets(Field* fd, const PlayedCard& origin)
+Storage<CardStatus>& get_potential_targets(Field* fd, const PlayedCard& origin)
 {
     return(origin.card->m_type == CardType::action ?
            skill_target_by_action<typename SkillTraits<skill_id>::TargetsWho, typename SkillTraits<skill_id>::TargetsWhat>(fd) :
@@ -2531,8 +3062,8 @@ template<unsigned skill_id>
 PlayedCard get_hostile_target(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
 {
     CardStatus* target = nullptr;
-    std::vector<CardStatus*>& potential_targets = get_potential_targets<skill_id>(fd, origin);
-    unsigned array_head = fill_valid_targets_array<skill_id>(fd, potential_targets, skill_spec);
+    Storage<CardStatus>& potential_targets = get_potential_targets<skill_id>(fd, origin);
+    unsigned array_head = PROFILED(phases[target_selection_profile], select_valid_targets<skill_id>(fd, potential_targets, skill_spec));
     if(array_head > 0)
     {
         unsigned rand_index(fd->rand(0, array_head - 1));
@@ -2664,8 +3195,8 @@ void maybe_proc_skill_and_queue_payback(Field* fd, const PlayedCard& origin, con
 template<unsigned skill_id>
 void perform_global_hostile_skill(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
 {
-    std::vector<CardStatus*>& cards(get_potential_targets<skill_id>(fd, origin));
-    unsigned array_head{select_fast<skill_id>(fd, origin.status, cards, skill_spec)};
+    Storage<CardStatus>& cards(get_potential_targets<skill_id>(fd, origin));
+    unsigned array_head{PROFILED(phases[target_selection_profile], select_fast<skill_id>(fd, origin.status, cards, skill_spec))};
     fd->payback_head = 0;
     for(unsigned s_index(0); s_index < array_head; ++s_index)
     {
@@ -2704,8 +3235,8 @@ bool target_tributes(Field* fd, const PlayedCard& origin, const PlayedCard& targ
 template<unsigned skill_id>
 void perform_targetted_allied_skill(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
 {
-    std::vector<CardStatus*>& cards(get_potential_targets<skill_id>(fd, origin));
-    unsigned array_head = select_fast<skill_id>(fd, origin.status, cards, skill_spec);
+    Storage<CardStatus>& cards(get_potential_targets<skill_id>(fd, origin));
+    unsigned array_head = PROFILED(phases[target_selection_profile], select_fast<skill_id>(fd, origin.status, cards, skill_spec));
     if(array_head > 0)
     {
         CardStatus* target_status(fd->selection_array[fd->rand(0, array_head - 1)]);
@@ -2725,8 +3256,8 @@ void perform_targetted_allied_skill(Field* fd, const PlayedCard& origin, const S
 template<unsigned skill_id>
 void perform_global_allied_skill(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
 {
-    std::vector<CardStatus*>& cards(get_potential_targets<skill_id>(fd, origin));
-    unsigned array_head{select_fast<skill_id>(fd, origin.status, cards, skill_spec)};
+    Storage<CardStatus>& cards(get_potential_targets<skill_id>(fd, origin));
+    unsigned array_head{PROFILED(phases[target_selection_profile], select_fast<skill_id>(fd, origin.status, cards, skill_spec))};
     for(unsigned s_index(0); s_index < array_head; ++s_index)
     {
         const PlayedCard target(fd->selection_array[s_index]->m_card, fd->selection_array[s_index]);
@@ -2744,20 +3275,20 @@ void perform_infuse(Field* fd, const PlayedCard& origin, const SkillSpec& s)
 {
     unsigned array_head = 0;
     // Select candidates among attacker's assaults
-    for(auto card_status: fd->players[origin.status->m_player]->assaults.m_indirect)
+    for(auto& card_status: fd->players[origin.status->m_player]->assaults)
     {
-        if(skill_predicate<infuse>(card_status))
+        if(skill_predicate<infuse>(&card_status))
         {
-            fd->selection_array[array_head] = card_status;
+            fd->selection_array[array_head] = &card_status;
             ++array_head;
         }
     }
     // Select candidates among defender's assaults
-    for(auto card_status: fd->players[opponent(origin.status->m_player)]->assaults.m_indirect)
+    for(auto& card_status: fd->players[opponent(origin.status->m_player)]->assaults)
     {
-        if(skill_predicate<infuse>(card_status))
+        if(skill_predicate<infuse>(&card_status))
         {
-            fd->selection_array[array_head] = card_status;
+            fd->selection_array[array_head] = &card_status;
             ++array_head;
         }
     }
@@ -2767,7 +3298,7 @@ void perform_infuse(Field* fd, const PlayedCard& origin, const SkillSpec& s)
         // check evade for enemy assaults only
         if(c->m_player == origin.status->m_player || !c->m_card->m_evade || fd->flip())
         {
-            _DEBUG_MSG("%s on (%s).", skill_names[infuse].c_str(), c->m_card->m_name.c_str());
+            _DEBUG_MSG("%s on (%s).", skill_names[infuse].c_str(), c->m_card->m_source->m_name.c_str());
             perform_skill<infuse>(fd, c, std::get<1>(s));
             _DEBUG_MSG("\n");
         }
@@ -2777,12 +3308,12 @@ void perform_infuse(Field* fd, const PlayedCard& origin, const SkillSpec& s)
 // a summoned card's on play skills seem to be evaluated before any other skills on the skill queue.
 inline void prepend_skills(Field* fd, const PlayedCard& summoned)
 {
-    for(auto& skill: boost::adaptors::reverse(summoned.card->m_skills_played))
+    for(auto& skill: boost::adaptors::reverse(summoned.card->skills_played()))
     {
         fd->skill_queue.emplace_front(summoned, skill);
     }
 }
-void summon_card(Field* fd, unsigned player, const Card* summoned)
+void summon_card(Field* fd, unsigned player, const CombatCard* summoned)
 {
     assert(summoned->m_type == CardType::assault || summoned->m_type == CardType::structure);
     Hand* hand{fd->players[player]};
@@ -2793,7 +3324,8 @@ void summon_card(Field* fd, unsigned player, const Card* summoned)
         card_status.set(summoned);
         card_status.m_index = storage->size() - 1;
         card_status.m_player = player;
-        _DEBUG_MSG("Summoned [%s] as %s %d\n", summoned->m_name.c_str(), cardtype_names[summoned->m_type].c_str(), card_status.m_index);
+        if(card_status.m_hp > 0) { hand->add_alive(card_status); }
+        _DEBUG_MSG("Summoned [%s] as %s %d\n", summoned->m_source->m_name.c_str(), cardtype_names[summoned->m_type].c_str(), card_status.m_index);
         prepend_skills(fd, PlayedCard(summoned, &card_status));
         if(card_status.m_card->m_blitz &&
            fd->players[opponent(player)]->assaults.size() > card_status.m_index &&
@@ -2806,7 +3338,11 @@ void summon_card(Field* fd, unsigned player, const Card* summoned)
 }
 void perform_summon(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
 {
-    summon_card(fd, origin.card->m_type == CardType::action ? fd->tapi : origin.status->m_player, fd->cards.by_id(std::get<1>(skill_spec)));
+    if(std::get<1>(skill_spec) == no_combat_card)
+    {
+        throw std::runtime_error("While summoning with the card [" + origin.card->m_source->m_name + "]: no such card.");
+    }
+    summon_card(fd, origin.card->m_type == CardType::action ? fd->tapi : origin.status->m_player, &fd->cards.combat_cards[std::get<1>(skill_spec)]);
 }
 
 void perform_trigger_regen(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
@@ -2816,7 +3352,7 @@ void perform_trigger_regen(Field* fd, const PlayedCard& origin, const SkillSpec&
 
 void perform_shock(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
 {
-    _DEBUG_MSG("Performing shock on (%s).", fd->tip->commander.m_card->m_name.c_str());
+    _DEBUG_MSG("Performing shock on (%s).", fd->tip->commander.m_card->m_source->m_name.c_str());
     perform_skill<shock>(fd, &fd->tip->commander, std::get<1>(skill_spec));
     _DEBUG_MSG("\n");
 }
@@ -2838,8 +3374,8 @@ void perform_mimic(Field* fd, const PlayedCard& origin, const SkillSpec& skill_s
     const PlayedCard& target(get_hostile_target<mimic>(fd, origin, skill_spec));
     if(target.card)
     {
-        _DEBUG_MSG("%s on (%s)\n", skill_names[std::get<0>(skill_spec)].c_str(), target.card->m_name.c_str());
-        for(auto skill: target.card->m_skills)
+        _DEBUG_MSG("%s on (%s)\n", skill_names[std::get<0>(skill_spec)].c_str(), target.card->m_source->m_name.c_str());
+        for(auto skill: target.card->skills())
         {
             if(origin.card->m_type == CardType::assault && origin.status->m_hp == 0)
             { break; }
@@ -2855,6 +3391,60 @@ void perform_mimic(Field* fd, const PlayedCard& origin, const SkillSpec& skill_s
     }
 }
 
+//------------------------------------------------------------------------------
+// Skill dispatch: a switch rather than a table of function pointers,
+// so that the implementation of each skill can be inlined in resolve_skill.
+inline void dispatch_skill(Field* fd, const PlayedCard& origin, const SkillSpec& skill_spec)
+{
+    switch(std::get<0>(skill_spec))
+    {
+    case augment: perform_targetted_allied_skill<augment>(fd, origin, skill_spec); break;
+    case augment_all: perform_global_allied_skill<augment>(fd, origin, skill_spec); break;
+    case chaos: perform_targetted_hostile_skill<chaos>(fd, origin, skill_spec); break;
+    case chaos_all: perform_global_hostile_skill<chaos>(fd, origin, skill_spec); break;
+    case cleanse: perform_targetted_allied_skill<cleanse>(fd, origin, skill_spec); break;
+    case cleanse_all: perform_global_allied_skill<cleanse>(fd, origin, skill_spec); break;
+    case enfeeble: perform_targetted_hostile_skill<enfeeble>(fd, origin, skill_spec); break;
+    case enfeeble_all: perform_global_hostile_skill<enfeeble>(fd, origin, skill_spec); break;
+    case freeze: perform_targetted_hostile_skill<freeze>(fd, origin, skill_spec); break;
+    case freeze_all: perform_global_hostile_skill<freeze>(fd, origin, skill_spec); break;
+    case heal: perform_targetted_allied_skill<heal>(fd, origin, skill_spec); break;
+    case heal_all: perform_global_allied_skill<heal>(fd, origin, skill_spec); break;
+    case infuse: perform_infuse(fd, origin, skill_spec); break;
+    case jam: perform_targetted_hostile_skill<jam>(fd, origin, skill_spec); break;
+    case jam_all: perform_global_hostile_skill<jam>(fd, origin, skill_spec); break;
+    case mimic: perform_mimic(fd, origin, skill_spec); break;
+    case protect: perform_targetted_allied_skill<protect>(fd, origin, skill_spec); break;
+    case protect_all: perform_global_allied_skill<protect>(fd, origin, skill_spec); break;
+    case rally: perform_targetted_allied_skill<rally>(fd, origin, skill_spec); break;
+    case rally_all: perform_global_allied_skill<rally>(fd, origin, skill_spec); break;
+    case rush: perform_targetted_allied_skill<rush>(fd, origin, skill_spec); break;
+    case shock: perform_shock(fd, origin, skill_spec); break;
+    case siege: perform_targetted_hostile_skill<siege>(fd, origin, skill_spec); break;
+    case siege_all: perform_global_hostile_skill<siege>(fd, origin, skill_spec); break;
+    case strike: perform_targetted_hostile_skill<strike>(fd, origin, skill_spec); break;
+    case strike_all: perform_global_hostile_skill<strike>(fd, origin, skill_spec); break;
+    case summon: perform_summon(fd, origin, skill_spec); break;
+    case supply: perform_supply(fd, origin, skill_spec); break;
+    case trigger_regen: perform_trigger_regen(fd, origin, skill_spec); break;
+    case weaken: perform_targetted_hostile_skill<weaken>(fd, origin, skill_spec); break;
+    case weaken_all: perform_global_hostile_skill<weaken>(fd, origin, skill_spec); break;
+    case num_skills: assert(false); break;
+    }
+}
+
+void resolve_skill(Field* fd)
+{
+    while(!fd->skill_queue.empty())
+    {
+        auto skill_instance(fd->skill_queue.front());
+        auto& status(std::get<0>(skill_instance));
+        auto& skill(std::get<1>(skill_instance));
+        fd->skill_queue.pop_front();
+        PROFILED(skills[std::get<0>(skill)], dispatch_skill(fd, status, skill));
+    }
+}
+
 //---------------------- $70 More xml parsing: missions and raids --------------
 // + also the custom decks
 struct Decks
@@ -2874,6 +3464,16 @@ struct Decks
             delete(obj.second);
         }
     }
+
+    void clear_missions_and_raids()
+    {
+        mission_decks.clear();
+        mission_decks_by_id.clear();
+        mission_decks_by_name.clear();
+        raid_decks.clear();
+        raid_decks_by_id.clear();
+        raid_decks_by_name.clear();
+    }
 };
 
 template<typename Iterator, typename Functor> Iterator advance_until(Iterator it, Iterator it_end, Functor f)
@@ -3029,6 +3629,7 @@ unsigned read_custom_decks(Cards& cards, std::string filename, std::map<std::str
         e.what();
         return(3);
     }
+    return(0);
 }
 //------------------------------------------------------------------------------
 void read_missions(Decks& decks, Cards& cards, std::string filename)
@@ -3055,13 +3656,8 @@ void read_missions(Decks& decks, Cards& cards, std::string filename)
                 card_node;
                 card_node = card_node->next_sibling())
             {
-                unsigned card_id{atoi(card_node->value())};
                 // Handle the replacement art cards
-                if(cards.replace.find(card_id) != cards.replace.end())
-                {
-                    card_id = cards.replace[card_id];
-                }
-                card_ids.push_back(card_id);
+                card_ids.push_back(cards.replacement(atoi(card_node->value())));
             }
             decks.mission_decks.push_back(DeckRandom{cards, card_ids});
             DeckRandom* deck = &decks.mission_decks.back();
@@ -3099,13 +3695,8 @@ void read_raids(Decks& decks, Cards& cards, std::string filename)
                     card_node;
                     card_node = card_node->next_sibling())
                 {
-                    unsigned card_id{atoi(card_node->value())};
                     // Handle the replacement art cards
-                    if(cards.replace.find(card_id) != cards.replace.end())
-                    {
-                        card_id = cards.replace[card_id];
-                    }
-                    always_cards.push_back(cards.by_id(card_id));
+                    always_cards.push_back(cards.by_id(cards.replacement(atoi(card_node->value()))));
                 }
             }
             for(xml_node<>* pool_node = always_node->next_sibling();
@@ -3121,13 +3712,8 @@ void read_raids(Decks& decks, Cards& cards, std::string filename)
                         card_node;
                         card_node = card_node->next_sibling())
                     {
-                        unsigned card_id{atoi(card_node->value())};
                         // Handle the replacement art cards
-                        if(cards.replace.find(card_id) != cards.replace.end())
-                        {
-                            card_id = cards.replace[card_id];
-                        }
-                        cards_from_pool.push_back(cards.by_id(card_id));
+                        cards_from_pool.push_back(cards.by_id(cards.replacement(atoi(card_node->value()))));
                     }
                     some_cards.push_back(std::make_pair(num_cards_from_pool, cards_from_pool));
                 }
@@ -3140,8 +3726,10 @@ void read_raids(Decks& decks, Cards& cards, std::string filename)
     }
 }
 //------------------------------------------------------------------------------
-void load_decks(Decks& decks, Cards& cards)
+// missions.xml and raids.xml. Returns false if one of them could not be parsed.
+bool load_decks(Decks& decks, Cards& cards)
 {
+    bool parsed{true};
     try
     {
         read_missions(decks, cards, "missions.xml");
@@ -3149,6 +3737,7 @@ void load_decks(Decks& decks, Cards& cards)
     catch(const rapidxml::parse_error& e)
     {
         std::cout << "\nException while loading decks from file missions.xml\n";
+        parsed = false;
     }
     try
     {
@@ -3157,7 +3746,13 @@ void load_decks(Decks& decks, Cards& cards)
     catch(const rapidxml::parse_error& e)
     {
         std::cout << "\nException while loading decks from file raids.xml\n";
+        parsed = false;
     }
+    return(parsed);
+}
+//------------------------------------------------------------------------------
+void load_custom_decks(Decks& decks, Cards& cards)
+{
     if(boost::filesystem::exists("Custom.txt"))
     {
         try
@@ -3190,6 +3785,304 @@ DeckIface* find_deck(const Decks& decks, std::string name)
     }
     return(nullptr);
 }
+//---------------------- $75 Binary cache of the xml files ---------------------
+// cards.xml, missions.xml and raids.xml parsed once and saved in cache_filename,
+// keyed by a hash of their contents: the cache is rebuilt when they change.
+// Bump cache_version whenever the layout below changes.
+const std::string cache_filename{"tyrant_optimize.cache"};
+const char cache_magic[8]{'T', 'O', 'C', 'A', 'C', 'H', 'E', '\0'};
+const uint32_t cache_version{1};
+
+// FNV-1a
+uint64_t hash_xml_files()
+{
+    uint64_t hash{14695981039346656037ull};
+    for(const char* filename: {"cards.xml", "missions.xml", "raids.xml"})
+    {
+        std::ifstream xml_file(filename, std::ios::binary | std::ios::ate);
+        std::vector<char> buffer(xml_file ? std::size_t(xml_file.tellg()) : 0);
+        xml_file.seekg(0);
+        xml_file.read(buffer.data(), buffer.size());
+        // Terminate each file, so that moving bytes from one file to the next changes the hash.
+        buffer.push_back('\0');
+        for(char c: buffer)
+        {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+        }
+    }
+    return(hash);
+}
+
+struct CacheWriter
+{
+    std::ostream& out;
+
+    void write(const void* data, std::size_t size) { out.write(static_cast<const char*>(data), size); }
+    void operator()(const unsigned& v) { write(&v, sizeof(v)); }
+    void operator()(const int& v) { write(&v, sizeof(v)); }
+    void operator()(const bool& v) { (*this)(unsigned(v)); }
+    template<typename Enum>
+    typename std::enable_if<std::is_enum<Enum>::value>::type operator()(const Enum& v) { (*this)(unsigned(v)); }
+    void operator()(const std::string& v)
+    {
+        (*this)(unsigned(v.size()));
+        write(v.data(), v.size());
+    }
+    void operator()(const std::vector<SkillSpec>& skills)
+    {
+        (*this)(unsigned(skills.size()));
+        for(const SkillSpec& skill: skills)
+        {
+            (*this)(std::get<0>(skill));
+            (*this)(std::get<1>(skill));
+            (*this)(std::get<2>(skill));
+        }
+    }
+};
+
+struct CacheReader
+{
+    const char* pos;
+    const char* end;
+
+    void read(void* data, std::size_t size)
+    {
+        if(size > std::size_t(end - pos))
+        {
+            throw std::runtime_error("While reading " + cache_filename + ": unexpected end of file.");
+        }
+        memcpy(data, pos, size);
+        pos += size;
+    }
+    void operator()(unsigned& v) { read(&v, sizeof(v)); }
+    void operator()(int& v) { read(&v, sizeof(v)); }
+    void operator()(bool& v) { unsigned u; (*this)(u); v = u; }
+    template<typename Enum>
+    typename std::enable_if<std::is_enum<Enum>::value>::type operator()(Enum& v) { unsigned u; (*this)(u); v = Enum(u); }
+    void operator()(std::string& v)
+    {
+        unsigned size;
+        (*this)(size);
+        if(size > std::size_t(end - pos))
+        {
+            throw std::runtime_error("While reading " + cache_filename + ": unexpected end of file.");
+        }
+        v.resize(size);
+        read(&v[0], size);
+    }
+    void operator()(std::vector<SkillSpec>& skills)
+    {
+        unsigned size;
+        (*this)(size);
+        skills.resize(size);
+        for(SkillSpec& skill: skills)
+        {
+            (*this)(std::get<0>(skill));
+            (*this)(std::get<1>(skill));
+            (*this)(std::get<2>(skill));
+        }
+    }
+};
+
+// The same field list is used to write and to read a card.
+template<typename Archive, typename CardRef>
+void cache_card(Archive& ar, CardRef& c)
+{
+    ar(c.m_id); ar(c.m_name); ar(c.m_type); ar(c.m_faction); ar(c.m_set); ar(c.m_rarity); ar(c.m_unique);
+    ar(c.m_attack); ar(c.m_health); ar(c.m_delay);
+    ar(c.m_antiair); ar(c.m_armored); ar(c.m_berserk); ar(c.m_berserk_oa); ar(c.m_blitz); ar(c.m_burst);
+    ar(c.m_counter); ar(c.m_crush); ar(c.m_disease); ar(c.m_disease_oa); ar(c.m_evade); ar(c.m_fear);
+    ar(c.m_flurry); ar(c.m_flying); ar(c.m_immobilize); ar(c.m_intercept); ar(c.m_leech); ar(c.m_payback);
+    ar(c.m_pierce); ar(c.m_poison); ar(c.m_poison_oa); ar(c.m_recharge); ar(c.m_refresh); ar(c.m_regenerate);
+    ar(c.m_siphon); ar(c.m_split); ar(c.m_swipe); ar(c.m_tribute); ar(c.m_valor); ar(c.m_wall);
+    ar(c.m_skills); ar(c.m_skills_played); ar(c.m_skills_died); ar(c.m_skills_attacked);
+}
+
+// Decks are written as card ids, then the maps by id and by name as indices in the deck list.
+void write_cache_decks(CacheWriter& out, const std::list<DeckRandom>& deck_list, const std::map<unsigned, DeckRandom*>& by_id, const std::map<std::string, DeckRandom*>& by_name)
+{
+    std::map<const DeckRandom*, unsigned> deck_index;
+    out(unsigned(deck_list.size()));
+    for(const DeckRandom& deck: deck_list)
+    {
+        deck_index.insert({&deck, deck_index.size()});
+        out(deck.commander->m_id);
+        out(unsigned(deck.cards.size()));
+        for(const Card* card: deck.cards) { out(card->m_id); }
+        out(unsigned(deck.raid_cards.size()));
+        for(auto& card_pool: deck.raid_cards)
+        {
+            out(card_pool.first);
+            out(unsigned(card_pool.second.size()));
+            for(const Card* card: card_pool.second) { out(card->m_id); }
+        }
+    }
+    out(unsigned(by_id.size()));
+    for(auto& id_deck: by_id)
+    {
+        out(id_deck.first);
+        out(deck_index[id_deck.second]);
+    }
+    out(unsigned(by_name.size()));
+    for(auto& name_deck: by_name)
+    {
+        out(name_deck.first);
+        out(deck_index[name_deck.second]);
+    }
+}
+
+void read_cache_decks(CacheReader& in, const Cards& cards, std::list<DeckRandom>& deck_list, std::map<unsigned, DeckRandom*>& by_id, std::map<std::string, DeckRandom*>& by_name)
+{
+    auto read_card = [&in, &cards]() -> const Card* { unsigned id; in(id); return(cards.by_id(id)); };
+    std::vector<DeckRandom*> decks;
+    unsigned num_decks;
+    in(num_decks);
+    for(unsigned deck_index(0); deck_index < num_decks; ++deck_index)
+    {
+        const Card* commander{read_card()};
+        std::vector<const Card*> deck_cards;
+        unsigned num_cards;
+        in(num_cards);
+        for(unsigned i(0); i < num_cards; ++i) { deck_cards.push_back(read_card()); }
+        std::vector<std::pair<unsigned, std::vector<const Card*> > > raid_cards;
+        unsigned num_pools;
+        in(num_pools);
+        for(unsigned pool_index(0); pool_index < num_pools; ++pool_index)
+        {
+            unsigned num_cards_from_pool;
+            in(num_cards_from_pool);
+            std::vector<const Card*> cards_from_pool;
+            in(num_cards);
+            for(unsigned i(0); i < num_cards; ++i) { cards_from_pool.push_back(read_card()); }
+            raid_cards.push_back(std::make_pair(num_cards_from_pool, cards_from_pool));
+        }
+        deck_list.push_back(DeckRandom{commander, deck_cards, raid_cards});
+        decks.push_back(&deck_list.back());
+    }
+    unsigned num_entries, index;
+    in(num_entries);
+    for(unsigned i(0); i < num_entries; ++i)
+    {
+        unsigned id;
+        in(id);
+        in(index);
+        by_id[id] = decks.at(index);
+    }
+    in(num_entries);
+    for(unsigned i(0); i < num_entries; ++i)
+    {
+        std::string name;
+        in(name);
+        in(index);
+        by_name[name] = decks.at(index);
+    }
+}
+
+void write_cache(const Cards& cards, const Decks& decks, uint64_t xml_hash)
+{
+    // Written next to the cache then renamed, so that concurrent runs never read half a file.
+    std::string tmp_filename{cache_filename + "." + boost::filesystem::unique_path().string()};
+    {
+        std::ofstream cache_file(tmp_filename, std::ios::binary);
+        CacheWriter out{cache_file};
+        out.write(cache_magic, sizeof(cache_magic));
+        out(cache_version);
+        out.write(&xml_hash, sizeof(xml_hash));
+        out(unsigned(cards.cards.size()));
+        for(const Card* card: cards.cards) { cache_card(out, *card); }
+        out(unsigned(cards.replace.size() - std::count(cards.replace.begin(), cards.replace.end(), 0u)));
+        for(unsigned id(0); id < cards.replace.size(); ++id)
+        {
+            if(cards.replace[id] == 0) { continue; }
+            out(id);
+            out(cards.replace[id]);
+        }
+        write_cache_decks(out, decks.mission_decks, decks.mission_decks_by_id, decks.mission_decks_by_name);
+        write_cache_decks(out, decks.raid_decks, decks.raid_decks_by_id, decks.raid_decks_by_name);
+        if(!cache_file)
+        {
+            cache_file.close();
+            boost::filesystem::remove(tmp_filename);
+            return;
+        }
+    }
+    boost::system::error_code error;
+    boost::filesystem::rename(tmp_filename, cache_filename, error);
+}
+
+// Returns false if there is no cache or if it is outdated; throws if it is corrupt.
+bool read_cache(Cards& cards, Decks& decks, uint64_t xml_hash)
+{
+    if(!boost::filesystem::exists(cache_filename) || boost::filesystem::file_size(cache_filename) == 0)
+    {
+        return(false);
+    }
+    boost::interprocess::file_mapping cache_file(cache_filename.c_str(), boost::interprocess::read_only);
+    boost::interprocess::mapped_region region(cache_file, boost::interprocess::read_only);
+    const char* data{static_cast<const char*>(region.get_address())};
+    CacheReader in{data, data + region.get_size()};
+    char magic[sizeof(cache_magic)];
+    uint32_t version;
+    uint64_t hash;
+    if(region.get_size() < sizeof(magic) + sizeof(version) + sizeof(hash))
+    {
+        return(false);
+    }
+    in.read(magic, sizeof(magic));
+    in(version);
+    in.read(&hash, sizeof(hash));
+    if(memcmp(magic, cache_magic, sizeof(magic)) != 0 || version != cache_version || hash != xml_hash)
+    {
+        return(false);
+    }
+    unsigned num_cards;
+    in(num_cards);
+    for(unsigned i(0); i < num_cards; ++i)
+    {
+        Card* c(new Card());
+        cards.cards.push_back(c);
+        cache_card(in, *c);
+    }
+    unsigned num_replaced;
+    in(num_replaced);
+    for(unsigned i(0); i < num_replaced; ++i)
+    {
+        unsigned id, replacement;
+        in(id);
+        in(replacement);
+        cards.add_replacement(id, replacement);
+    }
+    cards.organize();
+    read_cache_decks(in, cards, decks.mission_decks, decks.mission_decks_by_id, decks.mission_decks_by_name);
+    read_cache_decks(in, cards, decks.raid_decks, decks.raid_decks_by_id, decks.raid_decks_by_name);
+    return(true);
+}
+//------------------------------------------------------------------------------
+void load_cards_and_decks(Cards& cards, Decks& decks)
+{
+    uint64_t xml_hash{hash_xml_files()};
+    bool cache_read{false};
+    try
+    {
+        cache_read = read_cache(cards, decks, xml_hash);
+    }
+    catch(const std::exception& e)
+    {
+        // Corrupt cache: start over from the xml files, and rewrite it
+        std::cerr << "Ignoring " << cache_filename << " (" << e.what() << ")\n";
+        cards.clear();
+        decks.clear_missions_and_raids();
+    }
+    if(!cache_read)
+    {
+        read_cards(cards);
+        if(load_decks(decks, cards))
+        {
+            write_cache(cards, decks, xml_hash);
+        }
+    }
+    load_custom_decks(decks, cards);
+}
 //---------------------- $80 deck optimization ---------------------------------
 //------------------------------------------------------------------------------
 // Owned cards
@@ -3357,6 +4250,24 @@ double compute_efficiency(const std::pair<std::vector<unsigned> , unsigned>& res
 }
 //------------------------------------------------------------------------------
 bool use_efficiency{false};
+bool use_racing{false};
+// Common random numbers: the attack deck plays the same draw against all the defense decks of an iteration.
+bool shared_att_draw{false};
+// An iteration plays as many battles as there are defense decks, shared between them
+// in proportion to their factors rather than one against each; the factors then only weigh the draw.
+bool proportional_battles{false};
+// The candidate decks of compare_batch play the same battles (same random streams) as the best deck so far,
+// and are stopped early by a paired sign test against it.
+bool paired_comparison{false};
+// Iteration k of an evaluation always plays with the random stream battle_stream(evaluation, k),
+// or that of the deck it is paired with.
+// With -seed, a run is repeatable whatever the number of threads.
+uint64_t rng_seed(time(0));
+bool repeatable{false};
+inline uint64_t battle_stream(unsigned evaluation_id, unsigned iteration)
+{
+    return(CounterRng::mix(CounterRng::mix(rng_seed ^ CounterRng::mix(evaluation_id)) + iteration));
+}
 double compute_score(const std::pair<std::vector<unsigned> , unsigned>& results, std::vector<double>& factors)
 {
     double score{0.};
@@ -3364,9 +4275,8 @@ double compute_score(const std::pair<std::vector<unsigned> , unsigned>& results,
     {
         score = compute_efficiency(results);
     }
-    else
+    else if(results.second > 0)
     {
-        if(results.second == 0) { score = 0.; }
         double sum{0.};
         for(unsigned index(0); index < results.first.size(); ++index)
         {
@@ -3377,42 +4287,69 @@ double compute_score(const std::pair<std::vector<unsigned> , unsigned>& results,
     return(score);
 }
 //------------------------------------------------------------------------------
-volatile unsigned thread_num_iterations{0}; // written by threads
-std::vector<unsigned> thread_score; // written by threads
-volatile unsigned thread_total{0}; // written by threads
-volatile double thread_prev_score{0.0};
-volatile bool thread_compare{false};
-volatile bool thread_compare_stop{false}; // written by threads
-volatile bool destroy_threads;
-//------------------------------------------------------------------------------
 // Per thread data.
-// seed should be unique for each thread.
-// d1 and d2 are intended to point to read-only process-wide data.
+// The defense decks are cloned once; the attack deck is cloned once per evaluation.
+// The Field, the hands and the decks keep their memory from one battle to the next:
+// once warm, a battle does not allocate.
 struct SimulationData
 {
-    std::mt19937 re;
+    CounterRng re;
     const Cards& cards;
     const Decks& decks;
+    unsigned evaluation_id; // the evaluation att_deck was cloned for
     std::shared_ptr<DeckIface> att_deck;
     Hand att_hand;
     std::vector<std::shared_ptr<DeckIface> > def_decks;
     std::vector<Hand*> def_hands;
     std::vector<double> factors;
+    std::vector<double> battle_shares; // with proportional_battles: cumulated number of battles per defense deck
     gamemode_t gamemode;
+    unsigned att_features; // CombatFeature mask of att_deck
+    std::vector<unsigned> def_features; // per defense deck
+    Field fd;
+    std::vector<unsigned> results; // of the last iteration, per defense deck
+    unsigned long num_battles;
+    unsigned long num_turns;
+#ifdef COUNT_ALLOCATIONS
+    bool att_deck_warm; // att_deck has been shuffled at least once
+    unsigned long num_battle_allocations; // by the battles with a warm att_deck
+#endif
 
-    SimulationData(unsigned seed, const Cards& cards_, const Decks& decks_, unsigned num_def_decks_, std::vector<double> factors_, gamemode_t gamemode_) :
-        re(seed),
+    SimulationData(const Cards& cards_, const Decks& decks_, std::vector<DeckIface*> const & def_decks_, std::vector<double> factors_, gamemode_t gamemode_) :
         cards(cards_),
         decks(decks_),
+        evaluation_id(0),
         att_deck(),
         att_hand(nullptr),
-        def_decks(num_def_decks_),
         factors(factors_),
-        gamemode(gamemode_)
+        gamemode(gamemode_),
+        att_features(0),
+        fd(re, cards, att_hand, att_hand, gamemode),
+        results(def_decks_.size()),
+        num_battles(0),
+        num_turns(0)
+#ifdef COUNT_ALLOCATIONS
+        , att_deck_warm(false),
+        num_battle_allocations(0)
+#endif
     {
-        for(auto def_deck: def_decks)
+        for(auto def_deck: def_decks_)
+        {
+            def_decks.emplace_back(def_deck->clone());
+            def_hands.emplace_back(new Hand(def_decks.back().get()));
+            def_features.push_back(def_deck->features());
+        }
+        const double sum_factors(std::accumulate(factors.begin(), factors.end(), 0.));
+        double battle_share(0);
+        for(double factor: factors)
+        {
+            battle_share += factor * def_decks.size() / sum_factors;
+            battle_shares.push_back(battle_share);
+        }
+        // No battle lost to rounding
+        for(auto share_it(battle_shares.rbegin()); share_it != battle_shares.rend() && *share_it >= def_decks.size() - 0.5; ++share_it)
         {
-            def_hands.emplace_back(new Hand(nullptr));
+            *share_it = def_decks.size();
         }
     }
 
@@ -3421,37 +4358,196 @@ struct SimulationData
         for(auto hand: def_hands) { delete(hand); }
     }
 
-    void set_decks(const DeckIface* const att_deck_, std::vector<DeckIface*> const & def_decks_)
+    void set_att_deck(unsigned evaluation_id_, const DeckIface* const att_deck_)
+    {
+        if(evaluation_id_ != evaluation_id)
+        {
+            evaluation_id = evaluation_id_;
+            att_deck.reset(att_deck_->clone());
+            att_hand.deck = att_deck.get();
+            att_features = att_deck->features();
+#ifdef COUNT_ALLOCATIONS
+            att_deck_warm = false;
+#endif
+        }
+    }
+
+    // Returns the number of wins of the attack deck against each defense deck.
+    inline const std::vector<unsigned>& evaluate(unsigned stream_id, unsigned iteration)
     {
-        att_deck.reset(att_deck_->clone());
-        att_hand.deck = att_deck.get();
-        for(unsigned i(0); i < def_decks_.size(); ++i)
+#ifdef COUNT_ALLOCATIONS
+        const unsigned long num_allocations_before(num_allocations);
+#endif
+        re.seed(battle_stream(stream_id, iteration));
+        if(shared_att_draw) { att_hand.reset(re); }
+        if(proportional_battles)
+        {
+            // Systematic sampling: battle b is against the defense deck whose share contains b + offset
+            std::fill(results.begin(), results.end(), 0u);
+            const double offset((re() >> 11) * (1. / (uint64_t(1) << 53)));
+            unsigned battle(0);
+            for(unsigned index(0); index < def_hands.size(); ++index)
+            {
+                for(; battle < def_hands.size() && battle + offset < battle_shares[index]; ++battle)
+                {
+                    results[index] += play_battle(index);
+                }
+            }
+        }
+        else
         {
-            def_decks[i].reset(def_decks_[i]->clone());
-            def_hands[i]->deck = def_decks[i].get();
+            for(unsigned index(0); index < def_hands.size(); ++index)
+            {
+                results[index] = play_battle(index);
+            }
         }
+        num_battles += def_hands.size();
+#ifdef COUNT_ALLOCATIONS
+        if(att_deck_warm) { num_battle_allocations += num_allocations - num_allocations_before; }
+        att_deck_warm = true;
+#endif
+        return(results);
     }
 
-    inline std::vector<unsigned> evaluate()
+    // Returns 1 if the attack deck wins against the defense deck index, 0 otherwise.
+    inline unsigned play_battle(unsigned index)
     {
-        std::vector<unsigned> res;
-        for(Hand* def_hand: def_hands)
+        if(shared_att_draw) { att_hand.rewind(); }
+        else { att_hand.reset(re); }
+        def_hands[index]->reset(re);
+        fd.reset(att_hand, *def_hands[index]);
+        const unsigned winner(play(&fd, att_features | def_features[index]));
+        num_turns += fd.turn - 1;
+        return(winner == 0 ? 1 : 0);
+    }
+};
+//------------------------------------------------------------------------------
+// Work distribution: decks to evaluate are submitted to the Process as Evaluations.
+// The threads of the Process are persistent: each one joins the oldest evaluation
+// that still has iterations left, claims batches of iterations from it, and moves on
+// to the next evaluation as soon as there is nothing left to claim, instead of
+// waiting for the other threads to finish their battles.
+// Win tallies are kept locally and merged once per evaluation and thread.
+// In compare mode, they are merged after each batch instead, in blocks of
+// compare_check_interval iterations: the early stop is checked on each complete
+// prefix of blocks, so that it does not depend on the order the batches complete in.
+const unsigned num_evaluate_batches_per_thread{8};
+const unsigned num_compare_batches_per_thread{32};
+const unsigned compare_check_interval{100};
+// Racing: fewest battles a deck gets in the first round of successive halving.
+const unsigned racing_min_iterations{10};
+//------------------------------------------------------------------------------
+// Score to beat in compare mode. Shared by the evaluations of a batch,
+// and raised each time one of them completes with a better score.
+typedef std::atomic<double> PrevScore;
+//------------------------------------------------------------------------------
+// Paired comparison: the battles of the deck the candidates are compared to.
+struct PairedBaseline
+{
+    unsigned stream_id;
+    std::vector<float> iteration_scores;
+};
+//------------------------------------------------------------------------------
+struct Evaluation
+{
+    const unsigned id;
+    // Private copy: the caller is free to modify its deck while the evaluation is running.
+    const std::shared_ptr<DeckIface> att_deck;
+    const bool compare;
+    const std::shared_ptr<PrevScore> prev_score;
+    // Compare mode: if not null, paired with baseline instead of stopped against prev_score
+    const std::shared_ptr<const PairedBaseline> baseline;
+    const unsigned stream_id; // of the random streams of the battles
+    const unsigned batch_size; // number of iterations claimed at once
+    const unsigned num_iterations_total;
+    std::atomic<unsigned> num_iterations; // left to claim
+    std::atomic<bool> compare_stop; // written by threads
+    // Guarded by Process::shared_mutex
+    std::vector<unsigned> score;
+    unsigned total;
+    unsigned num_threads_working;
+    bool done;
+    // Compare mode: tallies of the blocks not merged into score yet
+    std::vector<std::vector<unsigned> > block_score;
+    std::vector<unsigned> block_total;
+    unsigned num_blocks_merged;
+    // Paired compare mode: iterations with a better and a worse score than the baseline
+    std::vector<std::array<unsigned, 2> > block_better_worse;
+    std::array<unsigned, 2> better_worse;
+    // With paired_comparison: the score of each iteration, written by the thread that plays it.
+    // Allocated by the first thread that joins; in compare mode, freed once done
+    // unless the evaluation is Process::paired_best.
+    std::vector<float> iteration_scores;
+
+    Evaluation(unsigned id_, const DeckIface* att_deck_, unsigned num_iterations_, bool compare_, const std::shared_ptr<PrevScore>& prev_score_,
+               const std::shared_ptr<const PairedBaseline>& baseline_, unsigned batch_size_, unsigned num_def_decks) :
+        id(id_),
+        att_deck(att_deck_->clone()),
+        compare(compare_),
+        prev_score(prev_score_),
+        baseline(baseline_),
+        stream_id(baseline_ ? baseline_->stream_id : id_),
+        batch_size(batch_size_),
+        num_iterations_total(num_iterations_),
+        num_iterations(num_iterations_),
+        compare_stop(false),
+        score(num_def_decks, 0u),
+        total(0),
+        num_threads_working(0),
+        done(num_iterations_ == 0),
+        block_score(compare ? (num_iterations_ + compare_check_interval - 1) / compare_check_interval : 0, std::vector<unsigned>(num_def_decks, 0u)),
+        block_total(block_score.size(), 0u),
+        num_blocks_merged(0),
+        block_better_worse(baseline ? block_score.size() : 0, std::array<unsigned, 2>{{0, 0}}),
+        better_worse{{0, 0}}
+    {
+        assert(!compare || compare_check_interval % batch_size == 0);
+        assert(!baseline || baseline->iteration_scores.size() >= num_iterations_);
+    }
+
+    // Claims up to batch_size iterations, starting at first_iteration;
+    // returns the number claimed (0: no more work).
+    unsigned claim_iterations(unsigned& first_iteration)
+    {
+        if(compare && compare_stop) { return(0); }
+        unsigned remaining(num_iterations.load());
+        while(remaining > 0)
         {
-            att_hand.reset(re);
-            def_hand->reset(re);
-            Field fd(re, cards, att_hand, *def_hand, gamemode);
-            unsigned result(play(&fd));
-            res.emplace_back(result);
+            const unsigned num_claimed(std::min(remaining, batch_size));
+            if(num_iterations.compare_exchange_weak(remaining, remaining - num_claimed))
+            {
+                first_iteration = num_iterations_total - remaining;
+                return(num_claimed);
+            }
         }
-        return(res);
+        return(0);
+    }
+
+    unsigned block_size(unsigned block) const
+    {
+        return(std::min(compare_check_interval, num_iterations_total - block * compare_check_interval));
     }
 };
 //------------------------------------------------------------------------------
+// Lower estimate of the number of wins, for the early stop in compare mode.
+// Multiple defense decks case: scaling by factors and approximation of a "discrete" number of events.
+unsigned compare_score_accum(const std::vector<unsigned>& score, const std::vector<double>& factors)
+{
+    if(score.size() > 1)
+    {
+        double score_accum_d = 0.0;
+        for(unsigned i = 0; i < score.size(); ++i)
+        {
+            score_accum_d += score[i] * factors[i];
+        }
+        score_accum_d /= std::accumulate(factors.begin(), factors.end(), .0d);
+        return(score_accum_d);
+    }
+    return(score[0]);
+}
+//------------------------------------------------------------------------------
 class Process;
-void thread_evaluate(boost::barrier& main_barrier,
-                     boost::mutex& shared_mutex,
-                     SimulationData& sim,
-                     const Process& p);
+void thread_evaluate(Process& p, SimulationData& sim);
 //------------------------------------------------------------------------------
 class Process
 {
@@ -3459,225 +4555,690 @@ public:
     unsigned num_threads;
     std::vector<boost::thread*> threads;
     std::vector<SimulationData*> threads_data;
-    boost::barrier main_barrier;
     boost::mutex shared_mutex;
+    boost::condition_variable work_available;
+    boost::condition_variable evaluation_done;
+    // Evaluations with iterations left to claim, oldest first
+    std::deque<std::shared_ptr<Evaluation> > pending_evaluations;
+    unsigned num_evaluations;
+    bool destroy_threads;
     const Cards& cards;
     const Decks& decks;
     DeckIface* att_deck;
     const std::vector<DeckIface*> def_decks;
     std::vector<double> factors;
     gamemode_t gamemode;
+    // With paired_comparison: the battles of the best deck so far
+    std::shared_ptr<const PairedBaseline> baseline;
+    // With paired_comparison, during compare_batch: the complete evaluation with the best score,
+    // the first submitted among equals. Guarded by shared_mutex.
+    std::shared_ptr<Evaluation> paired_best;
+    double paired_best_score;
 
     Process(unsigned _num_threads, const Cards& cards_, const Decks& decks_, DeckIface* att_deck_, std::vector<DeckIface*> _def_decks, std::vector<double> _factors, gamemode_t _gamemode) :
         num_threads(_num_threads),
-        main_barrier(num_threads+1),
+        num_evaluations(0),
+        destroy_threads(false),
         cards(cards_),
         decks(decks_),
         att_deck(att_deck_),
         def_decks(_def_decks),
-        factors(_factors),
-        gamemode(_gamemode)
+        factors(proportional_battles ? std::vector<double>(_factors.size(), 1.) : _factors),
+        gamemode(_gamemode),
+        paired_best_score(0.)
     {
-        destroy_threads = false;
-        unsigned seed(time(0));
         for(unsigned i(0); i < num_threads; ++i)
         {
-            threads_data.push_back(new SimulationData(seed + i, cards, decks, def_decks.size(), factors, gamemode));
-            threads.push_back(new boost::thread(thread_evaluate, std::ref(main_barrier), std::ref(shared_mutex), std::ref(*threads_data.back()), std::ref(*this)));
+            threads_data.push_back(new SimulationData(cards, decks, def_decks, _factors, gamemode));
+            threads.push_back(new boost::thread(thread_evaluate, std::ref(*this), std::ref(*threads_data.back())));
         }
     }
 
     ~Process()
     {
-        destroy_threads = true;
-        main_barrier.wait();
-        for(auto thread: threads) { thread->join(); }
+        {
+            boost::lock_guard<boost::mutex> lock(shared_mutex);
+            destroy_threads = true;
+        }
+        work_available.notify_all();
+        for(auto thread: threads) { thread->join(); delete(thread); }
         for(auto data: threads_data) { delete(data); }
     }
 
+    // Number of iterations a thread claims at once: enough batches per thread
+    // to balance the load, as few as possible to keep the threads independent.
+    unsigned batch_size(unsigned num_iterations, unsigned num_batches_per_thread) const
+    {
+        return(std::max(1u, num_iterations / (num_threads * num_batches_per_thread)));
+    }
+
+    // Queues the evaluation of deck; returns immediately.
+    std::shared_ptr<Evaluation> submit(const DeckIface* deck, unsigned num_iterations, bool compare, const std::shared_ptr<PrevScore>& prev_score,
+                                       const std::shared_ptr<const PairedBaseline>& paired_baseline = nullptr)
+    {
+        unsigned evaluation_batch_size(batch_size(num_iterations, compare ? num_compare_batches_per_thread : num_evaluate_batches_per_thread));
+        if(compare)
+        {
+            // A batch must not straddle two blocks
+            evaluation_batch_size = std::min(evaluation_batch_size, compare_check_interval);
+            while(compare_check_interval % evaluation_batch_size != 0) { --evaluation_batch_size; }
+        }
+        boost::lock_guard<boost::mutex> lock(shared_mutex);
+        std::shared_ptr<Evaluation> evaluation(std::make_shared<Evaluation>(++num_evaluations, deck, num_iterations, compare, prev_score, paired_baseline, evaluation_batch_size, def_decks.size()));
+        if(!evaluation->done)
+        {
+            pending_evaluations.push_back(evaluation);
+            work_available.notify_all();
+        }
+        return(evaluation);
+    }
+
+    // Blocks until all the battles of evaluation are done.
+    std::pair<std::vector<unsigned> , unsigned> wait(const std::shared_ptr<Evaluation>& evaluation)
+    {
+        boost::unique_lock<boost::mutex> lock(shared_mutex);
+        while(!evaluation->done) { evaluation_done.wait(lock); }
+        return(std::make_pair(evaluation->score, evaluation->total));
+    }
+
     std::pair<std::vector<unsigned> , unsigned> evaluate(unsigned num_iterations)
     {
-        thread_num_iterations = num_iterations;
-        thread_score = std::vector<unsigned>(def_decks.size(), 0u);
-        thread_total = 0;
-        thread_compare = false;
-        // unlock all the threads
-        main_barrier.wait();
-        // wait for the threads
-        main_barrier.wait();
-        return(std::make_pair(thread_score, thread_total));
-    }
-
-    std::pair<std::vector<unsigned> , unsigned> compare(unsigned num_iterations, double prev_score)
-    {
-        thread_num_iterations = num_iterations;
-        thread_score = std::vector<unsigned>(def_decks.size(), 0u);
-        thread_total = 0;
-        thread_prev_score = prev_score;
-        thread_compare = true;
-        thread_compare_stop = false;
-        // unlock all the threads
-        main_barrier.wait();
-        // wait for the threads
-        main_barrier.wait();
-        return(std::make_pair(thread_score, thread_total));
+        std::shared_ptr<Evaluation> evaluation(submit(att_deck, num_iterations, false, std::make_shared<PrevScore>(0.)));
+        auto results(wait(evaluation));
+        if(paired_comparison) { set_baseline(*evaluation); }
+        return(results);
     }
-};
-//------------------------------------------------------------------------------
-void thread_evaluate(boost::barrier& main_barrier,
-                     boost::mutex& shared_mutex,
-                     SimulationData& sim,
-                     const Process& p)
-{
-    while(true)
+
+    // Plays the attack deck on battles of its own, never those of the paired baseline.
+    std::pair<std::vector<unsigned> , unsigned> evaluate_fresh(unsigned num_iterations)
+    {
+        return(wait(submit(att_deck, num_iterations, false, std::make_shared<PrevScore>(0.))));
+    }
+
+    // evaluation must be done
+    void set_baseline(Evaluation& evaluation)
+    {
+        baseline = std::make_shared<PairedBaseline>(PairedBaseline{evaluation.stream_id, std::move(evaluation.iteration_scores)});
+    }
+
+    std::pair<std::vector<unsigned> , unsigned> compare(unsigned num_iterations, double prev_score, const DeckIface* deck = nullptr)
+    {
+        return(wait(submit(deck ? deck : att_deck, num_iterations, true, std::make_shared<PrevScore>(prev_score))));
+    }
+
+    // Compares all the decks at once, the threads being shared among them.
+    // Each deck is stopped early against the best score so far:
+    // prev_score, or the score of a deck of the batch that already completed.
+    // With paired_comparison, once the battles of the best deck so far are known, each deck plays
+    // the same battles and is also stopped early by a paired sign test against it;
+    // the decks stopped get empty results (0 battles). The best deck that beats prev_score,
+    // the one the callers keep, becomes the deck to pair with.
+    std::vector<std::pair<std::vector<unsigned> , unsigned> > compare_batch(unsigned num_iterations, const std::vector<std::shared_ptr<DeckIface> >& decks, double prev_score)
     {
-        main_barrier.wait();
-        sim.set_decks(p.att_deck, p.def_decks);
-        if(destroy_threads) { return; }
-        while(true)
+        if(use_racing && !paired_comparison && decks.size() > 2)
+        {
+            return(race(num_iterations, decks, prev_score));
+        }
+        std::shared_ptr<PrevScore> shared_prev_score(std::make_shared<PrevScore>(prev_score));
+        std::shared_ptr<const PairedBaseline> paired_baseline(baseline && baseline->iteration_scores.size() >= num_iterations ? baseline : nullptr);
+        if(paired_comparison)
+        {
+            boost::lock_guard<boost::mutex> lock(shared_mutex);
+            paired_best.reset();
+        }
+        std::vector<std::shared_ptr<Evaluation> > evaluations;
+        for(auto& deck: decks)
+        {
+            evaluations.emplace_back(submit(deck.get(), num_iterations, true, shared_prev_score, paired_baseline));
+        }
+        std::vector<std::pair<std::vector<unsigned> , unsigned> > results;
+        for(auto& evaluation: evaluations)
         {
-            shared_mutex.lock(); //<<<<
-            if(thread_num_iterations == 0 || (thread_compare && thread_compare_stop)) //!
+            results.emplace_back(wait(evaluation));
+            if(paired_baseline && evaluation->compare_stop)
             {
-                shared_mutex.unlock(); //>>>>
-                main_barrier.wait();
-                break;
+                results.back() = std::make_pair(std::vector<unsigned>(def_decks.size(), 0u), 0u);
             }
-            else
+        }
+        if(paired_comparison)
+        {
+            boost::lock_guard<boost::mutex> lock(shared_mutex);
+            if(paired_best && paired_best_score > prev_score) { set_baseline(*paired_best); }
+            paired_best.reset();
+        }
+        return(results);
+    }
+
+    // Successive halving: the decks are evaluated in rounds, all the contenders of a round
+    // at once. After each round, the contenders unlikely to beat prev_score are dropped,
+    // then the worse half of the others. The battles per contender double each round.
+    // The last contenders are then compared to prev_score as by compare_batch, on num_iterations
+    // fresh battles: the battles of the rounds they survived by scoring highest would favor them.
+    // Only those get results; the decks dropped on the way get empty results (0 battles).
+    std::vector<std::pair<std::vector<unsigned> , unsigned> > race(unsigned num_iterations, const std::vector<std::shared_ptr<DeckIface> >& decks, double prev_score)
+    {
+        std::vector<std::pair<std::vector<unsigned> , unsigned> > results(decks.size(), std::make_pair(std::vector<unsigned>(def_decks.size(), 0u), 0u));
+        std::vector<std::pair<std::vector<unsigned> , unsigned> > cumulated_results(results);
+        std::vector<unsigned> contenders(decks.size());
+        std::iota(contenders.begin(), contenders.end(), 0u);
+        unsigned num_rounds(1);
+        while((1u << num_rounds) < decks.size()) { ++num_rounds; }
+        std::shared_ptr<PrevScore> no_prev_score(std::make_shared<PrevScore>(0.));
+        for(unsigned round(1); round < num_rounds && contenders.size() > 1; ++round)
+        {
+            const unsigned round_iterations(std::min(num_iterations, std::max(num_iterations >> (num_rounds - round), racing_min_iterations)));
+            std::vector<std::shared_ptr<Evaluation> > evaluations;
+            for(unsigned deck_i: contenders)
             {
-                --thread_num_iterations; //!
-                shared_mutex.unlock(); //>>>>
-                std::vector<unsigned> result{sim.evaluate()};
-                shared_mutex.lock(); //<<<<
-                std::vector<unsigned> thread_score_local(thread_score.size(), 0); //!
-                for(unsigned index(0); index < result.size(); ++index)
-                {
-                    thread_score[index] += result[index] == 0 ? 1 : 0; //!
-                    thread_score_local[index] = thread_score[index]; // !
-                }
-                ++thread_total; //!
-                unsigned thread_total_local{thread_total}; //!
-                shared_mutex.unlock(); //>>>>
-                if(thread_compare && thread_total_local >= 1 && thread_total_local % 100 == 0)
+                evaluations.emplace_back(submit(decks[deck_i].get(), round_iterations - cumulated_results[deck_i].second, false, no_prev_score));
+            }
+            for(unsigned contender_i(0); contender_i < contenders.size(); ++contender_i)
+            {
+                auto round_results(wait(evaluations[contender_i]));
+                auto& deck_results(cumulated_results[contenders[contender_i]]);
+                for(unsigned index(0); index < round_results.first.size(); ++index)
                 {
-                    unsigned score_accum = 0;
-                    // Multiple defense decks case: scaling by factors and approximation of a "discrete" number of events.
-                    if(result.size() > 1)
-                    {
-                        double score_accum_d = 0.0;
-                        for(unsigned i = 0; i < thread_score_local.size(); ++i)
-                        {
-                            score_accum_d += thread_score_local[i] * sim.factors[i];
-                        }
-                        score_accum_d /= std::accumulate(sim.factors.begin(), sim.factors.end(), .0d);
-                        score_accum = score_accum_d;
-                    }
-                    else
-                    {
-                        score_accum = thread_score_local[0];
-                    }
-                    if(boost::math::binomial_distribution<>::find_upper_bound_on_p(thread_total_local, score_accum, 0.01) < thread_prev_score)
-                    {
-                        shared_mutex.lock(); //<<<<
-                        //std::cout << thread_total_local << "\n";
-                        thread_compare_stop = true; //!
-                        shared_mutex.unlock(); //>>>>
-                    }
+                    deck_results.first[index] += round_results.first[index];
                 }
+                deck_results.second += round_results.second;
             }
+            contenders.erase(std::remove_if(contenders.begin(), contenders.end(), [&](unsigned deck_i)
+                {
+                    auto& deck_results(cumulated_results[deck_i]);
+                    return(boost::math::binomial_distribution<>::find_upper_bound_on_p(deck_results.second, compare_score_accum(deck_results.first, factors), 0.01) < prev_score);
+                }), contenders.end());
+            std::stable_sort(contenders.begin(), contenders.end(), [&](unsigned deck_i, unsigned deck_j)
+                {
+                    return(compute_score(cumulated_results[deck_i], factors) > compute_score(cumulated_results[deck_j], factors));
+                });
+            contenders.resize((contenders.size() + 1) / 2);
+        }
+        std::shared_ptr<PrevScore> shared_prev_score(std::make_shared<PrevScore>(prev_score));
+        std::vector<std::shared_ptr<Evaluation> > evaluations;
+        for(unsigned deck_i: contenders)
+        {
+            evaluations.emplace_back(submit(decks[deck_i].get(), num_iterations, true, shared_prev_score));
+        }
+        for(unsigned contender_i(0); contender_i < contenders.size(); ++contender_i)
+        {
+            results[contenders[contender_i]] = wait(evaluations[contender_i]);
         }
+        return(results);
     }
-}
+};
 //------------------------------------------------------------------------------
-void print_score_info(const std::pair<std::vector<unsigned> , unsigned>& results, std::vector<double>& factors)
-{
-    std::cout << "win%: " << compute_score(results, factors) * 100.0 << " (";
-    for(auto val: results.first)
+// Performs battles of evaluation until there is nothing left to claim.
+void thread_run_evaluation(Process& p, SimulationData& sim, Evaluation& evaluation)
+{
+    std::vector<unsigned> score_local(evaluation.score.size(), 0);
+    unsigned total_local(0);
+    std::array<unsigned, 2> better_worse_local{{0, 0}};
+    const double sum_factors(std::accumulate(p.factors.begin(), p.factors.end(), 0.));
+    sim.set_att_deck(evaluation.id, evaluation.att_deck.get());
+    while(true)
     {
-        std::cout << val << " ";
+        unsigned first_iteration(0);
+        const unsigned num_claimed(evaluation.claim_iterations(first_iteration));
+        if(num_claimed == 0) { break; }
+        for(unsigned iteration(first_iteration); iteration < first_iteration + num_claimed; ++iteration)
+        {
+            const std::vector<unsigned>& result(sim.evaluate(evaluation.stream_id, iteration));
+            double iteration_score(0);
+            for(unsigned index(0); index < result.size(); ++index)
+            {
+                score_local[index] += result[index];
+                iteration_score += result[index] * p.factors[index];
+            }
+            if(!evaluation.iteration_scores.empty())
+            {
+                const float score(iteration_score / sum_factors);
+                evaluation.iteration_scores[iteration] = score;
+                if(evaluation.baseline && score != evaluation.baseline->iteration_scores[iteration])
+                {
+                    ++better_worse_local[score > evaluation.baseline->iteration_scores[iteration] ? 0 : 1];
+                }
+            }
+        }
+        total_local += num_claimed;
+        if(evaluation.compare)
+        {
+            const unsigned block(first_iteration / compare_check_interval);
+            boost::lock_guard<boost::mutex> lock(p.shared_mutex);
+            for(unsigned index(0); index < score_local.size(); ++index)
+            {
+                evaluation.block_score[block][index] += score_local[index];
+            }
+            evaluation.block_total[block] += total_local;
+            std::fill(score_local.begin(), score_local.end(), 0);
+            total_local = 0;
+            if(evaluation.baseline)
+            {
+                evaluation.block_better_worse[block][0] += better_worse_local[0];
+                evaluation.block_better_worse[block][1] += better_worse_local[1];
+                better_worse_local = {{0, 0}};
+            }
+            // Merge the complete blocks that follow the merged ones, checking the early stop after each
+            while(!evaluation.compare_stop && evaluation.num_blocks_merged < evaluation.block_total.size() &&
+                  evaluation.block_total[evaluation.num_blocks_merged] == evaluation.block_size(evaluation.num_blocks_merged))
+            {
+                const unsigned merged_block(evaluation.num_blocks_merged++);
+                for(unsigned index(0); index < evaluation.score.size(); ++index)
+                {
+                    evaluation.score[index] += evaluation.block_score[merged_block][index];
+                }
+                evaluation.total += evaluation.block_total[merged_block];
+                if(boost::math::binomial_distribution<>::find_upper_bound_on_p(evaluation.total, compare_score_accum(evaluation.score, p.factors), 0.01) < *evaluation.prev_score)
+                {
+                    evaluation.compare_stop = true;
+                }
+                if(evaluation.baseline)
+                {
+                    // Paired sign test: stop if the deck is significantly more often worse than better
+                    evaluation.better_worse[0] += evaluation.block_better_worse[merged_block][0];
+                    evaluation.better_worse[1] += evaluation.block_better_worse[merged_block][1];
+                    const unsigned num_different(evaluation.better_worse[0] + evaluation.better_worse[1]);
+                    if(num_different > 0 && boost::math::binomial_distribution<>::find_upper_bound_on_p(num_different, evaluation.better_worse[0], 0.01) < 0.5)
+                    {
+                        evaluation.compare_stop = true;
+                    }
+                }
+            }
+        }
+    }
+    if(!evaluation.compare)
+    {
+        boost::lock_guard<boost::mutex> lock(p.shared_mutex);
+        for(unsigned index(0); index < score_local.size(); ++index)
+        {
+            evaluation.score[index] += score_local[index];
+        }
+        evaluation.total += total_local;
     }
-    std::cout << "out of " << results.second << ")\n" << std::flush;
 }
 //------------------------------------------------------------------------------
-void hill_climbing(unsigned num_iterations, DeckIface* d1, Process& proc)
+void thread_evaluate(Process& p, SimulationData& sim)
 {
-    auto results = proc.evaluate(num_iterations);
-    print_score_info(results, proc.factors);
-    double current_score = compute_score(results, proc.factors);
-    double best_score = current_score;
-    // Non-commander cards
-    auto non_commander_cards = boost::join(boost::join(proc.cards.player_assaults, proc.cards.player_structures), proc.cards.player_actions);
-    const Card* best_commander = d1->commander;
-    std::vector<const Card*> best_cards = d1->cards;
-    bool deck_has_been_improved = true;
-    bool eval_commander = true;
-    while(deck_has_been_improved && best_score < 1.0)
+    while(true)
     {
-        deck_has_been_improved = false;
-        for(unsigned slot_i(0); slot_i < d1->cards.size(); ++slot_i)
+        std::shared_ptr<Evaluation> evaluation;
         {
-            if(eval_commander && !keep_commander)
+            boost::unique_lock<boost::mutex> lock(p.shared_mutex);
+            while(p.pending_evaluations.empty() && !p.destroy_threads) { p.work_available.wait(lock); }
+            if(p.pending_evaluations.empty())
             {
-                for(const Card* commander_candidate: proc.cards.player_commanders)
+#ifdef PROFILE_BATTLES
+                merge_thread_profile();
+#endif
+                return;
+            }
+            evaluation = p.pending_evaluations.front();
+            if(paired_comparison && evaluation->iteration_scores.empty())
+            {
+                evaluation->iteration_scores.resize(evaluation->num_iterations_total);
+            }
+            ++evaluation->num_threads_working;
+        }
+        thread_run_evaluation(p, sim, *evaluation);
+        {
+            boost::lock_guard<boost::mutex> lock(p.shared_mutex);
+            // Nothing left to claim: no other thread should join this evaluation
+            auto pending_it(std::find(p.pending_evaluations.begin(), p.pending_evaluations.end(), evaluation));
+            if(pending_it != p.pending_evaluations.end())
+            {
+                p.pending_evaluations.erase(pending_it);
+            }
+            if(--evaluation->num_threads_working == 0)
+            {
+                evaluation->done = true;
+                if(evaluation->compare && !repeatable)
                 {
-                    // Various checks to check if the card is accepted
-                    assert(commander_candidate->m_type == CardType::commander);
-                    if(commander_candidate == best_commander) { continue; }
-                    if(!suitable_commander(commander_candidate)) { continue; }
-                    // Place it in the deck
-                    d1->commander = commander_candidate;
-                    // Evaluate new deck
-                    auto compare_results = proc.compare(num_iterations, best_score);
-                    current_score = compute_score(compare_results, proc.factors);
-                    // Is it better ?
-                    if(current_score > best_score)
+                    // Raise the score to beat for the rest of the batch.
+                    // Not repeatable: depends on the order the evaluations complete in.
+                    const double score(compute_score(std::make_pair(evaluation->score, evaluation->total), p.factors));
+                    double prev_score(*evaluation->prev_score);
+                    while(score > prev_score && !evaluation->prev_score->compare_exchange_weak(prev_score, score)) {}
+                }
+                if(evaluation->compare && !evaluation->iteration_scores.empty())
+                {
+                    // Keep the iteration scores of the best complete evaluation only
+                    // (stopped by the paired test: no results, see compare_batch)
+                    const double score(compute_score(std::make_pair(evaluation->score, evaluation->total), p.factors));
+                    const bool complete(evaluation->total == evaluation->num_iterations_total && !(evaluation->baseline && evaluation->compare_stop));
+                    std::shared_ptr<Evaluation> released(evaluation);
+                    if(complete && (!p.paired_best || score > p.paired_best_score ||
+                        (score == p.paired_best_score && evaluation->id < p.paired_best->id)))
                     {
-                        // Then update best score/commander, print stuff
-                        best_score = current_score;
-                        best_commander = commander_candidate;
-                        deck_has_been_improved = true;
-                        std::cout << "Deck improved: commander -> " << commander_candidate->m_name << ": ";
-                        print_score_info(compare_results, proc.factors);
+                        released = p.paired_best;
+                        p.paired_best = evaluation;
+                        p.paired_best_score = score;
                     }
+                    if(released) { std::vector<float>().swap(released->iteration_scores); }
                 }
-                // Now that all commanders are evaluated, take the best one
-                d1->commander = best_commander;
-                eval_commander = false;
+                p.evaluation_done.notify_all();
             }
-            for(const Card* card_candidate: non_commander_cards)
+        }
+    }
+}
+//------------------------------------------------------------------------------
+void print_score_info(const std::pair<std::vector<unsigned> , unsigned>& results, std::vector<double>& factors)
+{
+    std::cout << "win%: " << compute_score(results, factors) * 100.0 << " (";
+    for(auto val: results.first)
+    {
+        std::cout << val << " ";
+    }
+    std::cout << "out of " << results.second << ")\n" << std::flush;
+}
+//------------------------------------------------------------------------------
+// State of a hill climb, advanced one step (one batch of candidate decks) at a time,
+// so that several climbs can share the threads of a Process.
+// A pass tries every card in every slot, and the commanders before a slot
+// if a slot has been improved since they were last tried. The climb ends with a pass without improvement.
+struct HillClimb
+{
+    DeckIface* deck;
+    const std::string prefix; // of the lines printed
+    double best_score;
+    const Card* best_commander;
+    std::vector<const Card*> best_cards;
+    unsigned slot_i;
+    bool eval_commander;
+    bool deck_has_been_improved;
+    // The current step: its candidates, commanders or cards for slot_i
+    bool commander_step;
+    std::vector<const Card*> candidates;
+
+    HillClimb(DeckIface* deck_, double score, const std::string& prefix_) :
+        deck(deck_),
+        prefix(prefix_),
+        best_score(score),
+        best_commander(deck_->commander),
+        best_cards(deck_->cards),
+        slot_i(deck_->cards.size()),
+        eval_commander(true),
+        deck_has_been_improved(true),
+        commander_step(false)
+    {}
+
+    // Places the candidate decks of the next step in candidate_decks; returns false if the climb is over.
+    bool next_step(const Cards& cards, std::vector<std::shared_ptr<DeckIface> >& candidate_decks)
+    {
+        candidates.clear();
+        candidate_decks.clear();
+        while(slot_i == deck->cards.size())
+        {
+            if(!deck_has_been_improved || best_score >= 1.0) { return(false); }
+            deck_has_been_improved = false;
+            slot_i = 0;
+        }
+        commander_step = eval_commander && !keep_commander;
+        if(commander_step)
+        {
+            for(const Card* commander_candidate: cards.player_commanders)
+            {
+                // Various checks to check if the card is accepted
+                assert(commander_candidate->m_type == CardType::commander);
+                if(commander_candidate == best_commander) { continue; }
+                if(!suitable_commander(commander_candidate)) { continue; }
+                // Place it in a copy of the deck
+                deck->commander = commander_candidate;
+                candidates.push_back(commander_candidate);
+                candidate_decks.emplace_back(deck->clone());
+            }
+            deck->commander = best_commander;
+        }
+        else
+        {
+            // Non-commander cards
+            for(const Card* card_candidate: boost::join(boost::join(cards.player_assaults, cards.player_structures), cards.player_actions))
             {
                 // Various checks to check if the card is accepted
                 assert(card_candidate->m_type != CardType::commander);
                 if(card_candidate == best_cards[slot_i]) { continue; }
-                if(!suitable_non_commander(*d1, slot_i, card_candidate)) { continue; }
-                // Place it in the deck
-                d1->cards[slot_i] = card_candidate;
-                // Evaluate new deck
-                auto compare_results = proc.compare(num_iterations, best_score);
-                current_score = compute_score(compare_results, proc.factors);
-                // Is it better ?
-                if(current_score > best_score)
+                if(!suitable_non_commander(*deck, slot_i, card_candidate)) { continue; }
+                // Place it in a copy of the deck
+                deck->cards[slot_i] = card_candidate;
+                candidates.push_back(card_candidate);
+                candidate_decks.emplace_back(deck->clone());
+            }
+            deck->cards[slot_i] = best_cards[slot_i];
+        }
+        return(true);
+    }
+
+    // Takes the best candidate of the step, if better than the deck.
+    void end_step(const std::vector<std::pair<std::vector<unsigned> , unsigned> >& batch_results, std::vector<double>& factors)
+    {
+        for(unsigned candidate_i(0); candidate_i < candidates.size(); ++candidate_i)
+        {
+            const Card* candidate(candidates[candidate_i]);
+            auto& compare_results(batch_results[candidate_i]);
+            const double current_score(compute_score(compare_results, factors));
+            // Is it better ?
+            if(current_score > best_score)
+            {
+                // Then update best score/commander or slot, print stuff
+                best_score = current_score;
+                deck_has_been_improved = true;
+                std::cout << prefix << "Deck improved: ";
+                if(commander_step)
                 {
-                    // Then update best score/slot, print stuff
-                    best_score = current_score;
-                    best_cards[slot_i] = card_candidate;
+                    best_commander = candidate;
+                    std::cout << "commander";
+                }
+                else
+                {
+                    best_cards[slot_i] = candidate;
                     eval_commander = true;
-                    deck_has_been_improved = true;
-                    std::cout << "Deck improved: slot " << slot_i << " -> " << card_candidate->m_name << ": ";
-                    print_score_info(compare_results, proc.factors);
+                    std::cout << "slot " << slot_i;
                 }
+                std::cout << " -> " << candidate->m_name << ": ";
+                print_score_info(compare_results, factors);
             }
-            // Now that all cards are evaluated, take the best one
-            d1->cards[slot_i] = best_cards[slot_i];
+        }
+        if(commander_step)
+        {
+            deck->commander = best_commander;
+            eval_commander = false;
+        }
+        else
+        {
+            deck->cards[slot_i] = best_cards[slot_i];
+            ++slot_i;
         }
     }
-    std::cout << "Best deck: " << best_score * 100.0 << "%\n";
-    std::cout << best_commander->m_name;
-    for(const Card* card: best_cards)
+
+    void print_best(const std::string& line_prefix) const
     {
-        std::cout << ", " << card->m_name;
+        std::cout << line_prefix << "Best deck: " << best_score * 100.0 << "%\n";
+        std::cout << line_prefix << best_commander->m_name;
+        for(const Card* card: best_cards)
+        {
+            std::cout << ", " << card->m_name;
+        }
+        std::cout << "\n";
     }
-    std::cout << "\n";
+};
+//------------------------------------------------------------------------------
+void hill_climbing(unsigned num_iterations, DeckIface* d1, Process& proc)
+{
+    auto results = proc.evaluate(num_iterations);
+    print_score_info(results, proc.factors);
+    HillClimb climb(d1, compute_score(results, proc.factors), "");
+    std::vector<std::shared_ptr<DeckIface> > candidate_decks;
+    while(climb.next_step(proc.cards, candidate_decks))
+    {
+        // Evaluate all the new decks at once
+        climb.end_step(proc.compare_batch(num_iterations, candidate_decks, climb.best_score), proc.factors);
+    }
+    if(paired_comparison)
+    {
+        // The best score was measured on the battles the deck was selected on
+        climb.best_score = compute_score(proc.evaluate_fresh(num_iterations), proc.factors);
+    }
+    climb.print_best("");
+}
+//------------------------------------------------------------------------------
+// Multi-start hill climbing: num_climbs climbs, from the attack deck and from random decks.
+// The steps of all the climbs are submitted at once, each climb stopping its candidates
+// early against its own best score; a deck that is a candidate of several climbs in the same round
+// is evaluated once. Every deck evaluation is kept for all the climbs:
+// a complete one is reused as is; one stopped early against a score to beat is reused
+// when comparing against a score at least as high, since the deck would be stopped again.
+// No racing nor paired comparison (rejected by main). The best deck found is left in d1.
+struct CachedEvaluation
+{
+    std::pair<std::vector<unsigned> , unsigned> results;
+    double stopped_below;
+};
+std::vector<unsigned> deck_key(const DeckIface& deck)
+{
+    std::vector<unsigned> key{deck.commander->m_id};
+    for(const Card* card: deck.cards) { key.push_back(card->m_id); }
+    // The order of the cards of a random deck does not matter
+    std::sort(key.begin() + 1, key.end());
+    return(key);
+}
+void multi_hill_climbing(unsigned num_iterations, unsigned num_climbs, DeckIface* d1, Process& proc)
+{
+    std::vector<std::shared_ptr<DeckIface> > start_decks;
+    for(unsigned climb_i(0); climb_i < num_climbs; ++climb_i)
+    {
+        start_decks.emplace_back(d1->clone());
+        if(climb_i == 0) { continue; }
+        // Random start deck, made of suitable cards; repeatable with -seed
+        DeckIface& deck(*start_decks.back());
+        CounterRng re(CounterRng::mix(rng_seed ^ CounterRng::mix(0x6d756c7469ull + climb_i)));
+        std::vector<const Card*> candidates;
+        for(const Card* commander_candidate: proc.cards.player_commanders)
+        {
+            if(suitable_commander(commander_candidate)) { candidates.push_back(commander_candidate); }
+        }
+        if(!candidates.empty()) { deck.commander = candidates[std::uniform_int_distribution<unsigned>(0, candidates.size() - 1)(re)]; }
+        for(unsigned slot_i(0); slot_i < deck.cards.size(); ++slot_i)
+        {
+            candidates.clear();
+            for(const Card* card_candidate: boost::join(boost::join(proc.cards.player_assaults, proc.cards.player_structures), proc.cards.player_actions))
+            {
+                if(suitable_non_commander(deck, slot_i, card_candidate)) { candidates.push_back(card_candidate); }
+            }
+            if(!candidates.empty()) { deck.cards[slot_i] = candidates[std::uniform_int_distribution<unsigned>(0, candidates.size() - 1)(re)]; }
+        }
+    }
+    std::map<std::vector<unsigned>, CachedEvaluation> cache;
+    unsigned num_evaluations(0);
+    unsigned num_reused(0);
+    std::vector<std::shared_ptr<Evaluation> > start_evaluations;
+    for(auto& deck: start_decks)
+    {
+        start_evaluations.emplace_back(proc.submit(deck.get(), num_iterations, false, std::make_shared<PrevScore>(0.)));
+    }
+    std::vector<HillClimb> climbs;
+    climbs.reserve(num_climbs);
+    for(unsigned climb_i(0); climb_i < num_climbs; ++climb_i)
+    {
+        auto results(proc.wait(start_evaluations[climb_i]));
+        const DeckIface& deck(*start_decks[climb_i]);
+        cache[deck_key(deck)] = CachedEvaluation{results, 0.};
+        climbs.emplace_back(start_decks[climb_i].get(), compute_score(results, proc.factors), "Climb " + boost::lexical_cast<std::string>(climb_i) + ": ");
+        std::cout << climbs.back().prefix << deck.commander->m_name;
+        for(const Card* card: deck.cards)
+        {
+            std::cout << ", " << card->m_name;
+        }
+        std::cout << ": ";
+        print_score_info(results, proc.factors);
+    }
+    std::vector<bool> running(num_climbs, true);
+    std::vector<std::vector<std::shared_ptr<DeckIface> > > candidate_decks(num_climbs);
+    std::vector<std::vector<std::pair<std::vector<unsigned> , unsigned> > > batch_results(num_climbs);
+    std::vector<std::shared_ptr<PrevScore> > prev_scores(num_climbs);
+    // The decks of a round not evaluated yet, each submitted once for all the climbs that have it as candidate
+    struct RoundEvaluation
+    {
+        std::shared_ptr<DeckIface> deck;
+        std::vector<unsigned> key;
+        std::vector<std::pair<unsigned, unsigned> > candidates; // climb, candidate
+        std::shared_ptr<PrevScore> prev_score;
+        std::shared_ptr<Evaluation> evaluation;
+    };
+    std::vector<RoundEvaluation> round_evaluations;
+    std::map<std::vector<unsigned>, unsigned> round_evaluation_index;
+    while(true)
+    {
+        // Gather the candidates of the next step of every climb, unless already evaluated
+        bool any_running(false);
+        round_evaluations.clear();
+        round_evaluation_index.clear();
+        for(unsigned climb_i(0); climb_i < num_climbs; ++climb_i)
+        {
+            running[climb_i] = running[climb_i] && climbs[climb_i].next_step(proc.cards, candidate_decks[climb_i]);
+            if(!running[climb_i]) { continue; }
+            any_running = true;
+            const double best_score(climbs[climb_i].best_score);
+            prev_scores[climb_i] = std::make_shared<PrevScore>(best_score);
+            batch_results[climb_i].assign(candidate_decks[climb_i].size(), std::pair<std::vector<unsigned> , unsigned>());
+            for(unsigned candidate_i(0); candidate_i < candidate_decks[climb_i].size(); ++candidate_i)
+            {
+                std::vector<unsigned> key(deck_key(*candidate_decks[climb_i][candidate_i]));
+                auto cache_it(cache.find(key));
+                if(cache_it != cache.end() && (cache_it->second.results.second == num_iterations || best_score >= cache_it->second.stopped_below))
+                {
+                    batch_results[climb_i][candidate_i] = cache_it->second.results;
+                    ++num_reused;
+                    continue;
+                }
+                auto index_it(round_evaluation_index.find(key));
+                if(index_it == round_evaluation_index.end())
+                {
+                    index_it = round_evaluation_index.insert({key, round_evaluations.size()}).first;
+                    round_evaluations.push_back(RoundEvaluation{candidate_decks[climb_i][candidate_i], key, {}, prev_scores[climb_i], nullptr});
+                    ++num_evaluations;
+                }
+                else
+                {
+                    // Shared with another climb: stopped against the lower of their scores to beat,
+                    // so that the result holds for both
+                    RoundEvaluation& shared(round_evaluations[index_it->second]);
+                    shared.prev_score = std::make_shared<PrevScore>(std::min<double>(best_score, *shared.prev_score));
+                    ++num_reused;
+                }
+                round_evaluations[index_it->second].candidates.emplace_back(climb_i, candidate_i);
+            }
+        }
+        if(!any_running) { break; }
+        for(RoundEvaluation& round_evaluation: round_evaluations)
+        {
+            round_evaluation.evaluation = proc.submit(round_evaluation.deck.get(), num_iterations, true, round_evaluation.prev_score);
+        }
+        for(RoundEvaluation& round_evaluation: round_evaluations)
+        {
+            auto results(proc.wait(round_evaluation.evaluation));
+            for(auto& candidate: round_evaluation.candidates)
+            {
+                batch_results[candidate.first][candidate.second] = results;
+            }
+        }
+        // Without -seed, the scores to beat may have been raised during the round
+        for(RoundEvaluation& round_evaluation: round_evaluations)
+        {
+            cache[round_evaluation.key] = CachedEvaluation{batch_results[round_evaluation.candidates.front().first][round_evaluation.candidates.front().second], *round_evaluation.prev_score};
+        }
+        for(unsigned climb_i(0); climb_i < num_climbs; ++climb_i)
+        {
+            if(running[climb_i]) { climbs[climb_i].end_step(batch_results[climb_i], proc.factors); }
+        }
+    }
+    unsigned best_climb_i(0);
+    for(unsigned climb_i(0); climb_i < num_climbs; ++climb_i)
+    {
+        climbs[climb_i].print_best(climbs[climb_i].prefix);
+        if(climbs[climb_i].best_score > climbs[best_climb_i].best_score) { best_climb_i = climb_i; }
+    }
+    std::cout << "Deck evaluations: " << num_evaluations << ", reused: " << num_reused << "\n";
+    d1->commander = climbs[best_climb_i].best_commander;
+    d1->cards = climbs[best_climb_i].best_cards;
+    climbs[best_climb_i].print_best("");
 }
 //------------------------------------------------------------------------------
 void hill_climbing_ordered(unsigned num_iterations, DeckOrdered* d1, Process& proc)
@@ -3704,19 +5265,27 @@ void hill_climbing_ordered(unsigned num_iterations, DeckOrdered* d1, Process& pr
         {
             unsigned current_slot(*remaining_cards.begin());
             remaining_cards.erase(remaining_cards.begin());
-            if(eval_commander && !keep_commander)
+            if(eval_commander && !keep_commander && best_score < 1.0)
             {
+                std::vector<const Card*> commander_candidates;
+                std::vector<std::shared_ptr<DeckIface> > candidate_decks;
                 for(const Card* commander_candidate: proc.cards.player_commanders)
                 {
-                    if(best_score == 1.0) { break; }
                     // Various checks to check if the card is accepted
                     assert(commander_candidate->m_type == CardType::commander);
                     if(commander_candidate == best_commander) { continue; }
                     if(!suitable_commander(commander_candidate)) { continue; }
-                    // Place it in the deck
+                    // Place it in a copy of the deck
                     d1->commander = commander_candidate;
-                    // Evaluate new deck
-                    auto compare_results = proc.compare(num_iterations, best_score);
+                    commander_candidates.push_back(commander_candidate);
+                    candidate_decks.emplace_back(d1->clone());
+                }
+                // Evaluate all the new decks at once
+                auto batch_results = proc.compare_batch(num_iterations, candidate_decks, best_score);
+                for(unsigned candidate_i(0); candidate_i < commander_candidates.size(); ++candidate_i)
+                {
+                    const Card* commander_candidate(commander_candidates[candidate_i]);
+                    auto& compare_results(batch_results[candidate_i]);
                     current_score = compute_score(compare_results, proc.factors);
                     // Is it better ?
                     if(current_score > best_score)
@@ -3733,9 +5302,11 @@ void hill_climbing_ordered(unsigned num_iterations, DeckOrdered* d1, Process& pr
                 d1->commander = best_commander;
                 eval_commander = false;
             }
+            if(best_score == 1.0) { break; }
+            std::vector<std::pair<const Card*, unsigned> > card_candidates;
+            std::vector<std::shared_ptr<DeckIface> > candidate_decks;
             for(const Card* card_candidate: non_commander_cards)
             {
-                if(best_score == 1.0) { break; }
                 // Various checks to check if the card is accepted
                 assert(card_candidate->m_type != CardType::commander);
                 for(unsigned slot_i(0); slot_i < d1->cards.size(); ++slot_i)
@@ -3743,31 +5314,142 @@ void hill_climbing_ordered(unsigned num_iterations, DeckOrdered* d1, Process& pr
                     // Various checks to check if the card is accepted
                     if(card_candidate == best_cards[slot_i]) { continue; }
                     if(!suitable_non_commander(*d1, current_slot, card_candidate)) { continue; }
-                    // Place it in the deck
+                    // Place it in a copy of the deck
                     d1->cards.erase(d1->cards.begin() + current_slot);
                     d1->cards.insert(d1->cards.begin() + slot_i, card_candidate);
-                    // Evaluate new deck
-                    auto compare_results = proc.compare(num_iterations, best_score);
-                    current_score = compute_score(compare_results, proc.factors);
-                    // Is it better ?
-                    if(current_score > best_score)
-                    {
-                        // Then update best score/slot, print stuff
-                        std::cout << "Deck improved: " << current_slot << " " << best_cards[current_slot]->m_name << " -> " << slot_i << " " << card_candidate->m_name << ": ";
-                        best_score = current_score;
-                        best_cards.erase(best_cards.begin() + current_slot);
-                        best_cards.insert(best_cards.begin() + slot_i, card_candidate);
-                        eval_commander = true;
-                        deck_has_been_improved = true;
-                        print_score_info(compare_results, proc.factors);
-                    }
+                    card_candidates.emplace_back(card_candidate, slot_i);
+                    candidate_decks.emplace_back(d1->clone());
                     d1->cards = best_cards;
                 }
             }
+            // Evaluate all the new decks at once
+            auto batch_results = proc.compare_batch(num_iterations, candidate_decks, best_score);
+            for(unsigned candidate_i(0); candidate_i < card_candidates.size(); ++candidate_i)
+            {
+                const Card* card_candidate(card_candidates[candidate_i].first);
+                const unsigned slot_i(card_candidates[candidate_i].second);
+                auto& compare_results(batch_results[candidate_i]);
+                current_score = compute_score(compare_results, proc.factors);
+                // Is it better ?
+                if(current_score > best_score)
+                {
+                    // Then update best score/slot, print stuff
+                    std::cout << "Deck improved: " << current_slot << " " << d1->cards[current_slot]->m_name << " -> " << slot_i << " " << card_candidate->m_name << ": ";
+                    best_score = current_score;
+                    best_cards = candidate_decks[candidate_i]->cards;
+                    eval_commander = true;
+                    deck_has_been_improved = true;
+                    print_score_info(compare_results, proc.factors);
+                }
+            }
+            d1->cards = best_cards;
             // Now that all cards are evaluated, take the best one
             // d1->cards[slot_i] = best_cards[slot_i];
         }
     }
+    if(paired_comparison)
+    {
+        // The best score was measured on the battles the deck was selected on
+        d1->commander = best_commander;
+        d1->cards = best_cards;
+        best_score = compute_score(proc.evaluate_fresh(num_iterations), proc.factors);
+    }
+    std::cout << "Best deck: " << best_score * 100.0 << "%\n";
+    std::cout << best_commander->m_name;
+    for(const Card* card: best_cards)
+    {
+        std::cout << ", " << card->m_name;
+    }
+    std::cout << "\n";
+}
+//------------------------------------------------------------------------------
+// Simulated annealing: random moves, each replacing the commander or the card of one slot.
+// A move is accepted if its score beats current_score + temperature * log(u), u uniform in (0, 1]:
+// always if it is better, and with probability exp(-drop / temperature) if its score drops.
+// u is drawn before the battles, so that a move can be stopped early once it is clearly below.
+// The temperature decreases geometrically from anneal_initial_temperature to anneal_final_temperature
+// as the battles played reach num_battles_budget. Not with paired comparison: a move that is
+// significantly worse than the current deck would always be stopped, i.e. rejected.
+// The temperatures are in standard errors of a score on num_iterations battles (at 50%):
+// the noise of the battles alone already accepts drops of about one standard error.
+const double anneal_initial_temperature{1.};
+const double anneal_final_temperature{0.05};
+void simulated_annealing(unsigned num_iterations, unsigned long num_battles_budget, DeckIface* d1, Process& proc)
+{
+    auto results = proc.evaluate(num_iterations);
+    print_score_info(results, proc.factors);
+    unsigned long num_battles(results.second);
+    double current_score = compute_score(results, proc.factors);
+    double best_score = current_score;
+    // Non-commander cards
+    auto non_commander_cards = boost::join(boost::join(proc.cards.player_assaults, proc.cards.player_structures), proc.cards.player_actions);
+    const Card* best_commander = d1->commander;
+    std::vector<const Card*> best_cards = d1->cards;
+    const unsigned num_slots(d1->cards.size() + (keep_commander ? 0 : 1));
+    // Repeatable with -seed
+    CounterRng re(CounterRng::mix(rng_seed ^ 0x616e6e65616cull));
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    // Consecutive draws of a slot without any candidate: give up after num_slots * 100 of them
+    unsigned num_empty_draws(0);
+    const double standard_error(0.5 / std::sqrt(num_iterations));
+    while(num_battles < num_battles_budget && best_score < 1.0 && num_empty_draws < num_slots * 100)
+    {
+        const double temperature(standard_error * anneal_initial_temperature * std::pow(anneal_final_temperature / anneal_initial_temperature, double(num_battles) / num_battles_budget));
+        // The commander is the last slot
+        const unsigned slot_i(std::uniform_int_distribution<unsigned>(0, num_slots - 1)(re));
+        const bool commander_move(slot_i == d1->cards.size());
+        std::vector<const Card*> candidates;
+        if(commander_move)
+        {
+            for(const Card* commander_candidate: proc.cards.player_commanders)
+            {
+                if(commander_candidate != d1->commander && suitable_commander(commander_candidate)) { candidates.push_back(commander_candidate); }
+            }
+        }
+        else
+        {
+            for(const Card* card_candidate: non_commander_cards)
+            {
+                if(card_candidate != d1->cards[slot_i] && suitable_non_commander(*d1, slot_i, card_candidate)) { candidates.push_back(card_candidate); }
+            }
+        }
+        if(candidates.empty())
+        {
+            ++num_empty_draws;
+            continue;
+        }
+        num_empty_draws = 0;
+        const Card* candidate(candidates[std::uniform_int_distribution<unsigned>(0, candidates.size() - 1)(re)]);
+        const Card*& moved_card(commander_move ? d1->commander : d1->cards[slot_i]);
+        const Card* previous_card(moved_card);
+        moved_card = candidate;
+        const double score_to_beat(current_score + temperature * std::log(1. - uniform(re)));
+        auto compare_results(proc.compare(num_iterations, score_to_beat, d1));
+        num_battles += compare_results.second;
+        const double score(compute_score(compare_results, proc.factors));
+        if(compare_results.second == 0 || score <= score_to_beat)
+        {
+            moved_card = previous_card;
+            continue;
+        }
+        current_score = score;
+        if(score > best_score)
+        {
+            best_score = score;
+            best_commander = d1->commander;
+            best_cards = d1->cards;
+            std::cout << "Deck improved: ";
+            if(commander_move) { std::cout << "commander"; }
+            else { std::cout << "slot " << slot_i; }
+            std::cout << " -> " << candidate->m_name << " (temperature " << temperature << "): ";
+            print_score_info(compare_results, proc.factors);
+        }
+    }
+    d1->commander = best_commander;
+    d1->cards = best_cards;
+    std::cout << "Battles: " << num_battles << "\n";
+    // The best score so far is the luckiest of the accepted ones
+    best_score = compute_score(proc.evaluate_fresh(num_iterations), proc.factors);
     std::cout << "Best deck: " << best_score * 100.0 << "%\n";
     std::cout << best_commander->m_name;
     for(const Card* card: best_cards)
@@ -3889,6 +5571,7 @@ inline void try_all_ratio_combinations(unsigned deck_size, unsigned var_k, unsig
     {
         var_k = cards_to_combine.size() - 1;
         Combination cardAmounts(num_cards_to_combine-1, var_k);
+        std::vector<std::shared_ptr<DeckIface> > candidate_decks;
         bool finished(false);
         while(!finished)
         {
@@ -3910,20 +5593,25 @@ inline void try_all_ratio_combinations(unsigned deck_size, unsigned var_k, unsig
             //std::cout << "\n" << std::flush;
             //std::cout << std::flush;
             assert(deck_cards.size() == deck_size);
-            DeckRandom deck(commander, deck_cards);
-            *proc.att_deck = deck;
-            auto new_results = proc.compare(num_iterations, best_score);
+            candidate_decks.emplace_back(new DeckRandom(commander, deck_cards));
+            ++total_num_combinations_test;
+            finished = cardAmounts.next();
+        }
+        // Evaluate all the ratio combinations at once
+        auto batch_results = proc.compare_batch(num_iterations, candidate_decks, best_score);
+        for(unsigned candidate_i(0); candidate_i < candidate_decks.size(); ++candidate_i)
+        {
+            auto& new_results(batch_results[candidate_i]);
             double new_score = compute_score(new_results, proc.factors);
             if(new_score > best_score)
             {
+                DeckRandom& deck(*dynamic_cast<DeckRandom*>(candidate_decks[candidate_i].get()));
                 best_score = new_score;
                 best_deck = deck;
                 print_score_info(new_results, proc.factors);
                 print_deck(deck);
                 std::cout << std::flush;
             }
-            ++total_num_combinations_test;
-            finished = cardAmounts.next();
         }
     }
 }
@@ -3970,11 +5658,117 @@ void exhaustive_k(unsigned num_iterations, unsigned var_k, Process& proc)
     }
     std::cout << "done " << num << "\n";
 }
+//---------------------- $85 Benchmark -----------------------------------------
+// Throughput of the battles alone (SimulationData::evaluate, no optimization logic):
+// num_iterations iterations of each benchmark set, for 1, 2, 4... up to max_threads threads.
+// The seed is fixed (0, or the one given by -seed).
+// Sets: fight and surge against the defense decks, the attack deck against itself,
+// and fight against the raid decks that have card pools.
+// Prints one tab separated line per set and number of threads;
+// allocations/battle is -1 unless built with -DCOUNT_ALLOCATIONS;
+// then returns false if a battle allocated once the buffers were warm.
+// First, the cost of one random draw of a battle: Field::flip and Field::rand,
+// and std::uniform_int_distribution on the same engine for comparison.
+const unsigned num_benchmark_draws{1u << 26};
+template<typename Draw>
+void benchmark_draws(const std::string& name, Draw draw)
+{
+    unsigned sum(0);
+    const auto start(std::chrono::steady_clock::now());
+    for(unsigned i(0); i < num_benchmark_draws; ++i) { sum += draw(); }
+    const double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    volatile unsigned sink(sum);
+    (void)sink;
+    std::cout << name << "\t" << num_benchmark_draws << "\t" << seconds * 1e9 / num_benchmark_draws << "\n";
+}
+void benchmark_random_draws(const Cards& cards)
+{
+    CounterRng re(rng_seed);
+    Hand hand(nullptr);
+    Field fd(re, cards, hand, hand, fight);
+    std::cout << "#draw\tcalls\tns/call\n";
+    benchmark_draws("flip", [&]() { return(fd.flip()); });
+    benchmark_draws("uniform_int(0, 1)", [&]() { return(std::uniform_int_distribution<unsigned>(0, 1)(re)); });
+    for(unsigned y: {2u, 5u, 9u})
+    {
+        benchmark_draws("rand(0, " + to_string(y) + ")", [&]() { return(fd.rand(0, y)); });
+        benchmark_draws("uniform_int(0, " + to_string(y) + ")", [&]() { return(std::uniform_int_distribution<unsigned>(0, y)(re)); });
+    }
+}
+//------------------------------------------------------------------------------
+bool benchmark(unsigned num_iterations, unsigned max_threads, const Cards& cards, const Decks& decks, DeckIface* att_deck, const std::vector<DeckIface*>& def_decks)
+{
+    benchmark_random_draws(cards);
+    bool no_battle_allocations(true);
+    const uint64_t saved_rng_seed(rng_seed);
+    if(!repeatable) { rng_seed = 0; }
+    std::vector<std::tuple<std::string, std::vector<DeckIface*>, gamemode_t> > sets{
+        std::make_tuple("fight", def_decks, fight),
+        std::make_tuple("surge", def_decks, surge),
+        std::make_tuple("mirror", std::vector<DeckIface*>{att_deck}, fight)};
+    std::vector<DeckIface*> raid_decks;
+    for(const DeckRandom& raid_deck: decks.raid_decks)
+    {
+        if(!raid_deck.raid_cards.empty()) { raid_decks.push_back(const_cast<DeckRandom*>(&raid_deck)); }
+    }
+    if(!raid_decks.empty()) { sets.emplace_back("raid", raid_decks, fight); }
+    std::vector<unsigned> threads_sweep;
+    for(unsigned num_threads(1); num_threads < max_threads; num_threads *= 2) { threads_sweep.push_back(num_threads); }
+    threads_sweep.push_back(max_threads);
+    std::cout << "#set\tthreads\tbattles\tseconds\tbattles/s\tns/battle\tturns/battle\tallocations/battle\n";
+    for(auto& set: sets)
+    {
+        const std::vector<DeckIface*>& set_def_decks(std::get<1>(set));
+        for(unsigned num_threads: threads_sweep)
+        {
+            Process p(num_threads, cards, decks, att_deck, set_def_decks, std::vector<double>(set_def_decks.size(), 1.0), std::get<2>(set));
+            // Warm up the buffers of the threads
+            p.evaluate(num_threads * num_evaluate_batches_per_thread);
+            auto sum_counters = [&p]()
+            {
+                std::array<unsigned long, 3> counters{{0, 0, 0}};
+                for(SimulationData* data: p.threads_data)
+                {
+                    counters[0] += data->num_battles;
+                    counters[1] += data->num_turns;
+#ifdef COUNT_ALLOCATIONS
+                    counters[2] += data->num_battle_allocations;
+#endif
+                }
+                return(counters);
+            };
+            const std::array<unsigned long, 3> counters_before(sum_counters());
+            const auto start(std::chrono::steady_clock::now());
+            p.evaluate(num_iterations);
+            const double seconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            const std::array<unsigned long, 3> counters_after(sum_counters());
+            const double num_battles(counters_after[0] - counters_before[0]);
+#ifdef COUNT_ALLOCATIONS
+            const double allocations_per_battle((counters_after[2] - counters_before[2]) / num_battles);
+            no_battle_allocations = no_battle_allocations && counters_after[2] == counters_before[2];
+#else
+            const double allocations_per_battle(-1);
+#endif
+            std::cout << std::get<0>(set) << "\t" << num_threads << "\t" << num_battles << "\t" << seconds << "\t"
+                      << num_battles / seconds << "\t" << seconds * 1e9 / num_battles << "\t"
+                      << (counters_after[1] - counters_before[1]) / num_battles << "\t" << allocations_per_battle << std::endl;
+        }
+    }
+    rng_seed = saved_rng_seed;
+    if(!no_battle_allocations)
+    {
+        std::cerr << "Battles allocated memory once the buffers were warm.\n";
+    }
+    return(no_battle_allocations);
+}
 //------------------------------------------------------------------------------
 enum Operation {
+    anneal,
     bruteforce,
     climb,
-    fightonce
+    multiclimb,
+    fightonce,
+    bench
 };
 //------------------------------------------------------------------------------
 // void print_raid_deck(DeckRandom& deck)
@@ -4036,7 +5830,7 @@ std::vector<std::pair<std::string, double> > parse_deck_list(std::string list_st
 
 void usage(int argc, char** argv)
 {
-    std::cout << "usage: " << argv[0] << " <attack deck> <defense decks list> [optional flags] [brute <num1> <num2>] [climb <num>]\n";
+    std::cout << "usage: " << argv[0] << " <attack deck> <defense decks list> [optional flags] [anneal <num1> <num2>] [brute <num1> <num2>] [climb <num>] [multiclimb <num1> <num2>]\n";
     std::cout << "\n";
     std::cout << "<attack deck>: the deck name of a custom deck.\n";
     std::cout << "<defense decks list>: semicolon separated list of defense decks, syntax:\n";
@@ -4046,14 +5840,22 @@ void usage(int argc, char** argv)
     std::cout << "\n";
     std::cout << "Flags:\n";
     std::cout << "  -c: don't try to optimize the commander.\n";
+    std::cout << "  -crn: the attack deck plays the same draw against all the defense decks of an iteration (common random numbers).\n";
     std::cout << "  -o: restrict hill climbing to the owned cards listed in \"ownedcards.txt\".\n";
+    std::cout << "  -paired: the candidate decks play the same battles as the best deck so far, and are stopped early when they are significantly more often worse than better (paired sign test); not combined with -race. Each improvement is still measured on the battles it was selected on, so the scores printed during a climb are biased upward; the best deck is played again on fresh battles at the end.\n";
+    std::cout << "  -proportional: share the battles of an iteration between the defense decks in proportion to their factors, instead of one battle against each; the win counts per deck are then out of its share of the battles.\n";
+    std::cout << "  -race: compare the candidate decks of a step by successive halving: fewer battles for the worse decks.\n";
     std::cout << "  -r: the attack deck is played in order instead of randomly (respects the 3 cards drawn limit).\n";
     std::cout << "  -s: use surge (default is fight).\n";
+    std::cout << "  -seed <num>: seed of the battles; the results are then the same on every run, whatever the number of threads.\n";
     std::cout << "  -t <num>: set the number of threads, default is 4.\n";
     std::cout << "  -turnlimit <num>: set the number of turns in a battle, default is 50 (can be used for speedy achievements).\n";
     std::cout << "Operations:\n";
+    std::cout << "anneal <num1> <num2>: perform simulated annealing starting from the given attack deck, using up to <num1> battles to evaluate a deck and <num2> battles in all; experimental: it has not been found better than climb with the same number of battles; not with -r nor -paired.\n";
+    std::cout << "bench <num>: measure the speed of the battles: <num> battles against each defense deck of a few fixed sets, with 1, 2, 4... up to the number of threads given by -t; first, the cost of the random draws of a battle.\n";
     std::cout << "brute <num1> <num2>: find the best combination of <num1> different cards, using up to <num2> battles to evaluate a deck.\n";
     std::cout << "climb <num>: perform hill-climbing starting from the given attack deck, using up to <num> battles to evaluate a deck.\n";
+    std::cout << "multiclimb <num1> <num2>: perform <num1> hill-climbings at once, from the given attack deck and from random decks, sharing the threads and the deck evaluations, using up to <num2> battles to evaluate a deck; not with -r, -paired nor -race.\n";
 }
 
 int main(int argc, char** argv)
@@ -4064,42 +5866,9 @@ int main(int argc, char** argv)
     gamemode_t gamemode = fight;
     bool ordered = false;
     Cards cards;
-    read_cards(cards);
-    read_owned_cards(cards);
     Decks decks;
-    load_decks(decks, cards);
-
-    skill_table[augment] = perform_targetted_allied_skill<augment>;
-    skill_table[augment_all] = perform_global_allied_skill<augment>;
-    skill_table[chaos] = perform_targetted_hostile_skill<chaos>;
-    skill_table[chaos_all] = perform_global_hostile_skill<chaos>;
-    skill_table[cleanse] = perform_targetted_allied_skill<cleanse>;
-    skill_table[cleanse_all] = perform_global_allied_skill<cleanse>;
-    skill_table[enfeeble] = perform_targetted_hostile_skill<enfeeble>;
-    skill_table[enfeeble_all] = perform_global_hostile_skill<enfeeble>;
-    skill_table[freeze] = perform_targetted_hostile_skill<freeze>;
-    skill_table[freeze_all] = perform_global_hostile_skill<freeze>;
-    skill_table[heal] = perform_targetted_allied_skill<heal>;
-    skill_table[heal_all] = perform_global_allied_skill<heal>;
-    skill_table[infuse] = perform_infuse;
-    skill_table[jam] = perform_targetted_hostile_skill<jam>;
-    skill_table[jam_all] = perform_global_hostile_skill<jam>;
-    skill_table[mimic] = perform_mimic;
-    skill_table[protect] = perform_targetted_allied_skill<protect>;
-    skill_table[protect_all] = perform_global_allied_skill<protect>;
-    skill_table[rally] = perform_targetted_allied_skill<rally>;
-    skill_table[rally_all] = perform_global_allied_skill<rally>;
-    skill_table[rush] = perform_targetted_allied_skill<rush>;
-    skill_table[shock] = perform_shock;
-    skill_table[siege] = perform_targetted_hostile_skill<siege>;
-    skill_table[siege_all] = perform_global_hostile_skill<siege>;
-    skill_table[strike] = perform_targetted_hostile_skill<strike>;
-    skill_table[strike_all] = perform_global_hostile_skill<strike>;
-    skill_table[supply] = perform_supply;
-    skill_table[summon] = perform_summon;
-    skill_table[trigger_regen] = perform_trigger_regen;
-    skill_table[weaken] = perform_targetted_hostile_skill<weaken>;
-    skill_table[weaken_all] = perform_global_hostile_skill<weaken>;
+    load_cards_and_decks(cards, decks);
+    read_owned_cards(cards);
 
     if(argc <= 2)
     {
@@ -4140,10 +5909,32 @@ int main(int argc, char** argv)
         {
             ordered = true;
         }
+        else if(strcmp(argv[argIndex], "-crn") == 0)
+        {
+            shared_att_draw = true;
+        }
+        else if(strcmp(argv[argIndex], "-paired") == 0)
+        {
+            paired_comparison = true;
+        }
+        else if(strcmp(argv[argIndex], "-proportional") == 0)
+        {
+            proportional_battles = true;
+        }
+        else if(strcmp(argv[argIndex], "-race") == 0)
+        {
+            use_racing = true;
+        }
         else if(strcmp(argv[argIndex], "-s") == 0)
         {
             gamemode = surge;
         }
+        else if(strcmp(argv[argIndex], "-seed") == 0)
+        {
+            rng_seed = strtoull(argv[argIndex+1], nullptr, 10);
+            repeatable = true;
+            argIndex += 1;
+        }
         else if(strcmp(argv[argIndex], "-t") == 0)
         {
             num_threads = atoi(argv[argIndex+1]);
@@ -4159,11 +5950,26 @@ int main(int argc, char** argv)
             todo.push_back(std::make_tuple((unsigned)atoi(argv[argIndex+1]), (unsigned)atoi(argv[argIndex+2]), bruteforce));
             argIndex += 2;
         }
+        else if(strcmp(argv[argIndex], "anneal") == 0)
+        {
+            todo.push_back(std::make_tuple((unsigned)atoi(argv[argIndex+1]), (unsigned)atoi(argv[argIndex+2]), anneal));
+            argIndex += 2;
+        }
         else if(strcmp(argv[argIndex], "climb") == 0)
         {
             todo.push_back(std::make_tuple((unsigned)atoi(argv[argIndex+1]), 0u, climb));
             argIndex += 1;
         }
+        else if(strcmp(argv[argIndex], "multiclimb") == 0)
+        {
+            todo.push_back(std::make_tuple((unsigned)std::max(1, atoi(argv[argIndex+1])), (unsigned)atoi(argv[argIndex+2]), multiclimb));
+            argIndex += 2;
+        }
+        else if(strcmp(argv[argIndex], "bench") == 0)
+        {
+            todo.push_back(std::make_tuple((unsigned)atoi(argv[argIndex+1]), 0u, bench));
+            argIndex += 1;
+        }
         else if(strcmp(argv[argIndex], "debug") == 0)
         {
             debug_print = true;
@@ -4203,6 +6009,15 @@ int main(int argc, char** argv)
         {
             switch(std::get<2>(op))
             {
+            case anneal: {
+                if(ordered || paired_comparison)
+                {
+                    std::cout << "anneal does not support -r nor -paired.\n";
+                    return(6);
+                }
+                simulated_annealing(std::get<0>(op), std::get<1>(op), att_deck, p);
+                break;
+            }
             case bruteforce: {
                 exhaustive_k(std::get<1>(op), std::get<0>(op), p);
                 break;
@@ -4218,10 +6033,26 @@ int main(int argc, char** argv)
                 }
                 break;
             }
+            case multiclimb: {
+                if(ordered || paired_comparison || use_racing)
+                {
+                    std::cout << "multiclimb does not support -r, -paired nor -race.\n";
+                    return(6);
+                }
+                multi_hill_climbing(std::get<1>(op), std::get<0>(op), att_deck, p);
+                break;
+            }
             case fightonce: {
                 p.evaluate(1);
                 break;
             }
+            case bench: {
+                if(!benchmark(std::get<0>(op), num_threads, cards, decks, att_deck, def_decks))
+                {
+                    return(7);
+                }
+                break;
+            }
             }
         }
     }